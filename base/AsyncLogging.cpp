@@ -0,0 +1,333 @@
+#include "AsyncLogging.h"
+
+#include <algorithm>
+
+using namespace base;
+
+std::atomic<int> AsyncLogging::nextInstance_(0);
+
+/*
+ *  构造函数
+ */
+AsyncLogging::AsyncLogging(const std::string& basename, off_t rollSize, int flushIntervalMs)
+        :
+        instance_(nextInstance_.fetch_add(1, std::memory_order_relaxed)),
+        basename_(basename),
+        rollSize_(rollSize),            /*单个日志文件的字节数上限*/
+        flushIntervalMs_(flushIntervalMs), /*没有缓冲写满时，最多隔这么久写一次文件*/
+        lossy_(false),                  /*默认过载时阻塞*/
+        dropped_(0),
+        reportedDropped_(0),
+        thread_(std::bind(&AsyncLogging::writeLogs,this,std::placeholders::_1)), /*后台线程*/
+        running_(false)
+{
+    pthread_mutex_init(&mutex_, nullptr);
+
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&cond_, &attr);
+    pthread_condattr_destroy(&attr);
+
+    pthread_cond_init(&drainedCond_, nullptr);
+}
+
+/*
+ *  析构函数
+ */
+AsyncLogging::~AsyncLogging()
+{
+    stop();
+
+    pthread_mutex_destroy(&mutex_);
+    pthread_cond_destroy(&cond_);
+    pthread_cond_destroy(&drainedCond_);
+}
+
+/*
+ *  写入一条完整的日志
+ *  只锁本线程的暂存缓冲；缓冲写满时换一个，过载时按lossy_丢弃或等待；后台线程没在运行时丢弃
+ */
+void AsyncLogging::append(const char* line, size_t len)
+{
+    if(!running_.load(std::memory_order_acquire))
+    {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    if(len > kBufferSize)
+        len = kBufferSize;
+
+    ThreadBuffer* threadBuffer = localBuffer();
+    pthread_mutex_lock(&threadBuffer->mutex_);
+    if((!threadBuffer->current_ || threadBuffer->current_->avail() < len) && !rotate(threadBuffer))
+    {
+        pthread_mutex_unlock(&threadBuffer->mutex_);
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    threadBuffer->current_->append(line, len);
+    pthread_mutex_unlock(&threadBuffer->mutex_);
+}
+
+/*
+ *  启动后台线程
+ *  可重复调用，每次启动打开一个新的日志文件
+ */
+void AsyncLogging::start()
+{
+    pthread_mutex_lock(&mutex_);
+    if(running_)
+    {
+        pthread_mutex_unlock(&mutex_);
+        return;
+    }
+    running_ = true;
+    pthread_mutex_unlock(&mutex_);
+
+    thread_.startThread();
+}
+
+/*
+ *  停止后台线程
+ *  后台线程退出前收走所有线程的暂存缓冲并写入文件；被阻塞的写日志线程随即返回
+ */
+void AsyncLogging::stop()
+{
+    pthread_mutex_lock(&mutex_);
+    if(!running_)
+    {
+        pthread_mutex_unlock(&mutex_);
+        return;
+    }
+    running_ = false;
+    pthread_cond_signal(&cond_);
+    pthread_cond_broadcast(&drainedCond_);
+    pthread_mutex_unlock(&mutex_);
+
+    thread_.joinThread();
+}
+
+/****************************************************************************************************************/
+
+/*
+ *  后台线程函数
+ *  等到有缓冲写满或flushIntervalMs_到期，收走各线程暂存的日志，写入文件后回收缓冲
+ */
+void* AsyncLogging::writeLogs(void* data)
+{
+    LogFile file(basename_, rollSize_);
+    std::vector<BufferPtr> buffers;
+
+    pthread_mutex_lock(&mutex_);
+    while(true)
+    {
+        if(running_ && fulls_.empty())
+        {
+            struct timespec deadline;
+            clock_gettime(CLOCK_MONOTONIC, &deadline);
+            deadline.tv_sec  += flushIntervalMs_ / 1000;
+            deadline.tv_nsec += static_cast<long>(flushIntervalMs_ % 1000) * 1000 * 1000;
+            if(deadline.tv_nsec >= 1000 * 1000 * 1000)
+            {
+                deadline.tv_sec  += 1;
+                deadline.tv_nsec -= 1000 * 1000 * 1000;
+            }
+            pthread_cond_timedwait(&cond_, &mutex_, &deadline);
+        }
+        bool stopping = !running_;
+        pthread_mutex_unlock(&mutex_);
+
+        // 先把各线程当前缓冲中的部分放入fulls_，再整体取走，同一线程的日志保持先后顺序
+        collectThreadBuffers(stopping);
+
+        pthread_mutex_lock(&mutex_);
+        buffers.swap(fulls_);
+        pthread_cond_broadcast(&drainedCond_);
+        pthread_mutex_unlock(&mutex_);
+
+        writeBuffers(buffers, file);
+
+        pthread_mutex_lock(&mutex_);
+        if(stopping)
+            break;
+    }
+    pthread_mutex_unlock(&mutex_);
+
+    return nullptr;
+}
+
+/*
+ *  把各线程当前缓冲中已写的部分放入fulls_，换上空缓冲
+ *  平时用trylock，线程正在写或正阻塞等待时跳过它，下一轮再收；停止时要收全，用lock
+ *  已退出的线程收取后从threads_中删除
+ */
+void AsyncLogging::collectThreadBuffers(bool stopping)
+{
+    pthread_mutex_lock(&mutex_);
+    std::vector<std::shared_ptr<ThreadBuffer>> threads(threads_);
+    pthread_mutex_unlock(&mutex_);
+
+    for(const std::shared_ptr<ThreadBuffer>& threadBuffer : threads)
+    {
+        if(stopping)
+            pthread_mutex_lock(&threadBuffer->mutex_);
+        else if(pthread_mutex_trylock(&threadBuffer->mutex_) != 0)
+            continue;
+
+        bool exited = threadBuffer->exited_;
+        if(threadBuffer->current_ && threadBuffer->current_->length() > 0)
+        {
+            pthread_mutex_lock(&mutex_);
+            fulls_.push_back(std::move(threadBuffer->current_));
+            if(!exited)
+            {
+                threadBuffer->current_ = takeFreeBuffer();
+                if(!threadBuffer->spare_)
+                    threadBuffer->spare_ = takeFreeBuffer(); // 还在写日志的线程备好备用缓冲，写满时不用等
+            }
+            pthread_mutex_unlock(&mutex_);
+        }
+        pthread_mutex_unlock(&threadBuffer->mutex_);
+
+        if(exited)
+        {
+            pthread_mutex_lock(&mutex_);
+            threads_.erase(std::remove(threads_.begin(), threads_.end(), threadBuffer), threads_.end());
+            pthread_mutex_unlock(&mutex_);
+        }
+    }
+}
+
+/*
+ *  写入一批缓冲，刷新文件，回收缓冲
+ */
+void AsyncLogging::writeBuffers(std::vector<BufferPtr>& buffers, LogFile& file)
+{
+    int64_t dropped = dropped_.load(std::memory_order_relaxed);
+    if(dropped > reportedDropped_)
+    {
+        char note[128];
+        int n = snprintf(note, sizeof note, "AsyncLogging dropped %lld log lines\n",
+                         static_cast<long long>(dropped - reportedDropped_));
+        file.append(note, static_cast<size_t>(n));
+        reportedDropped_ = dropped;
+    }
+
+    if(buffers.empty())
+        return;
+
+    for(const BufferPtr& buffer : buffers)
+        file.append(buffer->data(), buffer->length());
+    file.flush();
+
+    pthread_mutex_lock(&mutex_);
+    for(BufferPtr& buffer : buffers)
+    {
+        if(frees_.size() >= kMaxFreeBuffers)
+            break;
+        buffer->reset();
+        frees_.push_back(std::move(buffer));
+    }
+    pthread_mutex_unlock(&mutex_);
+    buffers.clear();
+}
+
+/*
+ *  本线程的暂存缓冲，第一次调用时创建并登记
+ *  线程退出时标记exited_，由后台线程收走剩下的日志
+ */
+AsyncLogging::ThreadBuffer* AsyncLogging::localBuffer()
+{
+    struct LocalHandle
+    {
+        LocalHandle(): instance_(-1){}
+        ~LocalHandle(){ release(); }
+
+        void release()
+        {
+            if(!buffer_)
+                return;
+            pthread_mutex_lock(&buffer_->mutex_);
+            buffer_->exited_ = true;
+            pthread_mutex_unlock(&buffer_->mutex_);
+            buffer_.reset();
+        }
+
+        int instance_;
+        std::shared_ptr<ThreadBuffer> buffer_;
+    };
+    static thread_local LocalHandle local;
+
+    if(local.instance_ != instance_)
+    {
+        local.release();
+
+        std::shared_ptr<ThreadBuffer> threadBuffer = std::make_shared<ThreadBuffer>();
+        threadBuffer->exited_ = false;
+
+        pthread_mutex_lock(&mutex_);
+        threadBuffer->current_ = takeFreeBuffer();
+        threads_.push_back(threadBuffer);
+        pthread_mutex_unlock(&mutex_);
+
+        local.instance_ = instance_;
+        local.buffer_   = threadBuffer;
+    }
+    return local.buffer_.get();
+}
+
+/*
+ *  当前缓冲写满，交给后台线程并换上备用缓冲
+ *  调用时持有threadBuffer->mutex_；待写的缓冲太多时，lossy_为true返回false，否则等后台线程取走一批
+ *  后台线程已停止时没有人会取走fulls_，返回false，由append()丢弃这条日志
+ */
+bool AsyncLogging::rotate(ThreadBuffer* threadBuffer)
+{
+    pthread_mutex_lock(&mutex_);
+    if(!running_)
+    {
+        pthread_mutex_unlock(&mutex_);
+        return false;
+    }
+
+    if(fulls_.size() >= kMaxQueuedBuffers)
+    {
+        if(lossy_.load(std::memory_order_relaxed))
+        {
+            pthread_mutex_unlock(&mutex_);
+            return false;
+        }
+        while(fulls_.size() >= kMaxQueuedBuffers && running_)
+            pthread_cond_wait(&drainedCond_, &mutex_);
+        if(!running_) // 等待期间被stop()
+        {
+            pthread_mutex_unlock(&mutex_);
+            return false;
+        }
+    }
+
+    if(threadBuffer->current_ && threadBuffer->current_->length() > 0)
+    {
+        fulls_.push_back(std::move(threadBuffer->current_));
+        pthread_cond_signal(&cond_);
+    }
+    threadBuffer->current_ = threadBuffer->spare_ ? std::move(threadBuffer->spare_) : takeFreeBuffer();
+    pthread_mutex_unlock(&mutex_);
+    return true;
+}
+
+/*
+ *  取一个空闲缓冲，没有就新建
+ *  调用时持有mutex_
+ */
+AsyncLogging::BufferPtr AsyncLogging::takeFreeBuffer()
+{
+    if(frees_.empty())
+        return BufferPtr(new LogBuffer);
+
+    BufferPtr buffer = std::move(frees_.back());
+    frees_.pop_back();
+    return buffer;
+}
@@ -0,0 +1,110 @@
+#ifndef ASYNCLOGGING_H
+#define ASYNCLOGGING_H
+
+#include "noncopyable.h"
+#include "Thread.h"
+#include "LogFile.h"
+
+namespace base
+{
+    /*
+     *  异步日志，由后台线程成批写入滚动文件
+     *  每个写日志的线程有自己的一对暂存缓冲（当前 + 备用），append()只锁自己的缓冲，这把锁只有后台线程偶尔来抢，
+     *  IO线程、任务线程写日志时不争同一把锁，也没有系统调用。
+     *  当前缓冲写满时与备用缓冲交换（没有备用时从空闲列表取），写满的缓冲放入fulls_，唤醒后台线程；
+     *  后台线程每隔flushInterval（或有缓冲写满时）把各线程当前缓冲中的部分也收走，一起写入文件后回收缓冲。
+     *  同一线程的日志在文件中保持顺序，不同线程的日志按批交错。
+     *
+     *  待写的缓冲达到kMaxQueuedBuffers时说明后台写不过来：
+     *  默认阻塞写日志的线程直到后台取走一批；setLossy(true)时丢弃这条日志并计数，后台在文件中记下丢弃的条数。
+     *  start()之前、stop()之后没有后台线程写文件，此时的日志也丢弃并计数，不在内存中堆积。
+     *
+     *  用法：start()后Logger::setOutput(std::bind(&AsyncLogging::append,&log,_1,_2))，
+     *  Logger::setFlush(std::bind(&AsyncLogging::stop,&log))使FATAL日志abort()前写完。
+     * */
+    class AsyncLogging : noncopyable
+    {
+    public:
+        static const size_t kBufferSize       = 64 * 1024; // 每个暂存缓冲的大小
+        static const size_t kMaxQueuedBuffers = 64;        // 写满待写的缓冲上限，即4MB
+        static const size_t kMaxFreeBuffers   = 16;        // 后台线程保留的空闲缓冲数
+
+        explicit AsyncLogging(const std::string& basename,
+                              off_t rollSize = 64 * 1024 * 1024,
+                              int flushIntervalMs = 1000);
+        ~AsyncLogging();
+
+        /// 可跨线程调用
+        void append(const char* line, size_t len);
+        void start();
+        void stop(); // 写完所有暂存的日志后返回，可重复调用
+
+        void setLossy(bool on){ lossy_.store(on, std::memory_order_relaxed); } // 过载时丢弃而不阻塞
+        int64_t getDropped(){ return dropped_.load(std::memory_order_relaxed); } // 累计丢弃的日志条数
+
+    private:
+        // 一个暂存缓冲
+        class LogBuffer : noncopyable
+        {
+        public:
+            explicit LogBuffer(): len_(0){}
+
+            void append(const char* data, size_t len){ memcpy(data_ + len_, data, len); len_ += len; }
+            void reset(){ len_ = 0; }
+
+            const char* data() const { return data_; }
+            size_t length() const { return len_; }
+            size_t avail() const { return sizeof data_ - len_; }
+
+        private:
+            char   data_[kBufferSize];
+            size_t len_;
+        };
+
+        using BufferPtr = std::unique_ptr<LogBuffer>;
+
+        // 一个线程的暂存缓冲，线程局部变量和threads_各持有一份引用
+        struct ThreadBuffer
+        {
+            explicit ThreadBuffer(){ pthread_mutex_init(&mutex_, nullptr); }
+            ~ThreadBuffer(){ pthread_mutex_destroy(&mutex_); }
+
+            pthread_mutex_t mutex_;   // 所属线程append()和后台线程收取时加锁
+            BufferPtr       current_; // 正在写的缓冲
+            BufferPtr       spare_;   // 备用缓冲
+            bool            exited_;  // 所属线程已退出，收取后从threads_中删除
+        };
+
+        /// 不可跨线程调用
+        void* writeLogs(void* data);
+        void  collectThreadBuffers(bool stopping);
+        void  writeBuffers(std::vector<BufferPtr>& buffers, LogFile& file);
+
+        ThreadBuffer* localBuffer();
+        bool rotate(ThreadBuffer* threadBuffer);
+        BufferPtr takeFreeBuffer();
+
+    private:
+        static std::atomic<int> nextInstance_; // 区分不同的AsyncLogging对象，线程局部的暂存缓冲属于哪个对象
+
+        const int   instance_;
+        std::string basename_;
+        off_t       rollSize_;
+        int         flushIntervalMs_;
+
+        std::atomic<bool>    lossy_;
+        std::atomic<int64_t> dropped_;
+        int64_t              reportedDropped_; // 已在文件中记下的丢弃条数，只有后台线程访问
+
+        Thread          thread_;       // 后台线程
+        std::atomic<bool> running_;    // 后台线程是否在运行，append()不加锁读取
+        pthread_mutex_t mutex_;        // 保护以下成员
+        pthread_cond_t  cond_;         // 有缓冲写满、stop()时唤醒后台线程
+        pthread_cond_t  drainedCond_;  // 后台取走一批缓冲时唤醒被阻塞的写日志线程
+        std::vector<BufferPtr> fulls_; // 待写的缓冲，同一线程的缓冲按写满的先后排列
+        std::vector<BufferPtr> frees_; // 空闲缓冲
+        std::vector<std::shared_ptr<ThreadBuffer>> threads_; // 各写日志线程的暂存缓冲
+    };
+}
+
+#endif //ASYNCLOGGING_H
@@ -6,10 +6,11 @@ const char Buffer::kCRLF[] = "\r\n";
 
 /*
  *  将数据从内核缓冲区读取并保存到buffer的应用层缓冲区，不负责字节序的转换
+ *  extrabuf是线程局部的，同一个线程中的所有连接共用一块，不必每次调用都在栈上占64K
  */
 ssize_t Buffer::readFd(int fd, int* savedErrno)
 {
-    char extrabuf[65536]; // 64k
+    static thread_local char extrabuf[65536]; // 64k
     struct iovec vec[2];
     const size_t writable = writableBytes();
     // 第一块缓冲区：buffer本身可写的空间
@@ -5,6 +5,7 @@
 
 #include "Types.h"
 #include "copyable.h"
+#include "PoolAllocator.h"
 
 namespace base
 {
@@ -13,6 +14,7 @@ namespace base
      * Buffer中的数据都是网络字节序
      * 调用readxxx()、peekxxx()会将Buffer中数据读取并转换成主机字节序，再返回给调用者；
      * 调用appendxxx()时，调用者需要先将主机字节序的数据转换成网络字节序再传入；
+     * 传入SlabPool时缓存从内存池分配，连接关闭后留给下一个连接复用；
      * */
     class Buffer : public copyable
     {
@@ -20,8 +22,9 @@ namespace base
         static const size_t kCheapPrepend = 8;
         static const size_t kInitialSize = 1024;
 
-        explicit Buffer(size_t initialSize = kInitialSize)
-                : buffer_(kCheapPrepend + initialSize),
+        explicit Buffer(size_t initialSize = kInitialSize,
+                        std::shared_ptr<SlabPool> pool = std::shared_ptr<SlabPool>())
+                : buffer_(kCheapPrepend + initialSize, PoolAllocator<char>(std::move(pool))),
                   readerIndex_(kCheapPrepend),
                   writerIndex_(kCheapPrepend)
         {
@@ -269,12 +272,20 @@ namespace base
         // 利用swap技法伸缩vector的空间为reserve个字节
         void shrink(size_t reserve)
         {
-            Buffer other;
+            Buffer other(kInitialSize, buffer_.get_allocator().getPool());
             other.ensureWritableBytes(readableBytes()+reserve);
             other.append(peek(),readableBytes());
             swap(other);
         }
 
+        // 数据已经取完时释放全部存储，只保留kCheapPrepend，空闲连接几乎不占内存
+        void release()
+        {
+            assert(readableBytes() == 0);
+            Buffer other(0, buffer_.get_allocator().getPool());
+            swap(other);
+        }
+
         size_t internalCapacity() const
         {
             return buffer_.capacity();
@@ -313,7 +324,7 @@ namespace base
         }
 
     private:
-        std::vector<char> buffer_; // buffer用vector管理缓存
+        std::vector<char, PoolAllocator<char>> buffer_; // buffer用vector管理缓存
         size_t readerIndex_;       // 读的起始位置（读写相对于用户端来说）
         size_t writerIndex_;       // 写的起始位置（读写相对于用户端来说）
 
@@ -0,0 +1,145 @@
+#include "ChainBuffer.h"
+
+using namespace base;
+
+/*
+ *  构造函数
+ */
+ChainBuffer::ChainBuffer(std::shared_ptr<SlabPool> pool)
+        : allocator_(std::move(pool)),
+          tailBlockUsed_(0),
+          readableBytes_(0)
+{
+}
+
+/*
+ *  复制一段数据到缓冲尾部
+ *  先填满尾部Block剩余的空间，不够时再申请新的Block
+ */
+void ChainBuffer::append(const char* data, size_t len)
+{
+    readableBytes_ += len;
+
+    while(len > 0)
+    {
+        if(!tailBlock_ || tailBlockUsed_ == kBlockSize)
+        {
+            tailBlock_ = newBlock();
+            tailBlockUsed_ = 0;
+
+            Segment segment;
+            segment.owner_ = tailBlock_;
+            segment.data_  = tailBlock_->data_;
+            segment.len_   = 0;
+            segments_.push_back(std::move(segment));
+        }
+
+        size_t n = std::min(len, kBlockSize - tailBlockUsed_);
+        memcpy(tailBlock_->data_ + tailBlockUsed_, data, n);
+        tailBlockUsed_ += n;
+        segments_.back().len_ += n; // 尾部Block一定对应最后一段
+        data += n;
+        len  -= n;
+    }
+}
+
+/*
+ *  追加一条共享消息中从offset开始的部分
+ *  足够大的消息只增加引用计数，不复制数据；太小的消息复制进Block，免得分段太碎
+ */
+void ChainBuffer::append(const SharedMessage& message, size_t offset)
+{
+    if(!message || offset >= message->size())
+        return;
+
+    size_t len = message->size() - offset;
+    if(len < kShareThreshold)
+    {
+        append(message->data() + offset, len);
+        return;
+    }
+
+    Segment segment;
+    segment.owner_ = message;
+    segment.data_  = message->data() + offset;
+    segment.len_   = len;
+    segments_.push_back(std::move(segment));
+    readableBytes_ += len;
+
+    tailBlock_.reset(); // 之后的小消息要写进新的Block，保持分段的顺序
+}
+
+/*
+ *  丢弃前len字节，发完的分段释放其存储的引用
+ */
+void ChainBuffer::retrieve(size_t len)
+{
+    assert(len <= readableBytes_);
+    readableBytes_ -= len;
+
+    while(len > 0)
+    {
+        Segment& front = segments_.front();
+        if(len < front.len_)
+        {
+            front.data_ += len;
+            front.len_  -= len;
+            return;
+        }
+
+        len -= front.len_;
+        if(segments_.size() == 1)
+        {
+            tailBlock_.reset(); // 全部发完，尾部Block没有必要留着
+            tailBlockUsed_ = 0;
+        }
+        segments_.pop_front();
+    }
+}
+
+/*
+ *  清空缓冲
+ */
+void ChainBuffer::retrieveAll()
+{
+    segments_.clear();
+    tailBlock_.reset();
+    tailBlockUsed_ = 0;
+    readableBytes_ = 0;
+}
+
+/*
+ *  用writev()把前面最多kMaxIovecs个分段写入fd，写出多少就丢弃多少
+ */
+ssize_t ChainBuffer::writeFd(int fd, int* savedErrno)
+{
+    struct iovec vec[kMaxIovecs];
+    int iovcnt = 0;
+    for(std::deque<Segment>::const_iterator it = segments_.begin();
+        it != segments_.end() && iovcnt < kMaxIovecs;
+        ++it)
+    {
+        vec[iovcnt].iov_base = const_cast<char*>(it->data_);
+        vec[iovcnt].iov_len  = it->len_;
+        ++iovcnt;
+    }
+
+    const ssize_t n = ::writev(fd, vec, iovcnt);
+    if(n < 0)
+        *savedErrno = errno;
+    else
+        retrieve(static_cast<size_t>(n));
+    return n;
+}
+
+/*
+ *  从内存池申请一个Block
+ *  Block本身正好kBlockSize字节，引用计数控制块单独分配，两者都落在内存池合适的级别中
+ */
+std::shared_ptr<ChainBuffer::Block> ChainBuffer::newBlock()
+{
+    Block* block = allocator_.allocate(1);
+    BlockDeleter deleter;
+    deleter.allocator_ = allocator_;
+    return std::shared_ptr<Block>(block, std::move(deleter), allocator_);
+}
@@ -0,0 +1,78 @@
+#ifndef CHAINBUFFER_H
+#define CHAINBUFFER_H
+
+#include <deque>
+#include <limits.h>
+
+#include "noncopyable.h"
+#include "PoolAllocator.h"
+
+namespace base
+{
+    /*
+     *  链式输出缓冲
+     *  数据保存在一串分段（Segment）中，每段引用一块不可变的存储：
+     *  1.小消息复制到定长的Block中，多条小消息紧凑地填进同一个Block；
+     *  2.大消息（SharedMessage）直接引用其std::string，不复制，同一个SharedMessage可以同时挂在很多连接的缓冲上。
+     *  存储由shared_ptr引用计数管理，最后一个引用它的分段被发完时释放。
+     *
+     *  追加数据时从不移动已有数据（不像Buffer::makeSpace()那样memmove或整体扩容），
+     *  writeFd()用writev()一次把最多kMaxIovecs个分段交给内核。
+     *  Block从所属EventLoop的SlabPool分配，发完后回到内存池。
+     *  只在所属IO线程中使用，不可跨线程调用。
+     * */
+    class ChainBuffer : noncopyable
+    {
+    public:
+        static const size_t kBlockSize      = 4096; // 每个Block的字节数
+        static const size_t kShareThreshold = 512;  // 不小于这个长度的SharedMessage直接引用，不复制
+        static const int    kMaxIovecs      = IOV_MAX < 1024 ? IOV_MAX : 1024; // 每次writev的最大分段数
+
+        explicit ChainBuffer(std::shared_ptr<SlabPool> pool = std::shared_ptr<SlabPool>());
+
+        size_t readableBytes() const { return readableBytes_; }
+        size_t segmentNum() const { return segments_.size(); }
+
+        void append(const char* data, size_t len);
+        void append(const SharedMessage& message, size_t offset = 0);
+
+        void retrieve(size_t len);
+        void retrieveAll();
+
+        // 把数据写入socket，返回实际写出的字节数，出错时返回-1并通过savedErrno返回errno
+        ssize_t writeFd(int fd, int* savedErrno);
+
+    private:
+        // 定长存储块，只有尾部Block可以继续写入
+        struct Block
+        {
+            char data_[kBlockSize];
+        };
+
+        // 一段待发送数据，owner_保证data_指向的存储在发送完之前有效
+        struct Segment
+        {
+            std::shared_ptr<const void> owner_;
+            const char* data_;
+            size_t      len_;
+        };
+
+        // 把Block还给内存池
+        struct BlockDeleter
+        {
+            PoolAllocator<Block> allocator_;
+            void operator()(Block* block){ allocator_.deallocate(block, 1); }
+        };
+
+        std::shared_ptr<Block> newBlock();
+
+    private:
+        PoolAllocator<Block>   allocator_;     // Block及其引用计数控制块的分配器
+        std::deque<Segment>    segments_;
+        std::shared_ptr<Block> tailBlock_;     // 最后一段所在的Block，还能往后追加；最后一段不是Block时为空
+        size_t                 tailBlockUsed_; // tailBlock_已经写入的字节数
+        size_t                 readableBytes_; // 所有分段的总字节数
+    };
+}
+
+#endif //CHAINBUFFER_H
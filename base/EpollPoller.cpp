@@ -0,0 +1,68 @@
+#include "EpollPoller.h"
+
+using namespace base;
+
+/*
+ *  构造函数
+ */
+EpollPoller::EpollPoller():
+        epollfd_(epoll_create1(EPOLL_CLOEXEC))
+{
+}
+
+/*
+ *  析构函数
+ */
+EpollPoller::~EpollPoller()
+{
+    close(epollfd_);
+}
+
+/*
+ *  等待就绪事件
+ *  events被填满时成倍地扩展大小，下次就能取回更多事件
+ */
+int EpollPoller::poll(int timeoutMs, std::vector<struct epoll_event>* events)
+{
+    int numEvent = epoll_wait(epollfd_,&(*events->begin()), static_cast<int>(events->size()),timeoutMs);
+    if(numEvent < 0) // EINTR等情况，当作没有事件
+        return 0;
+
+    if(numEvent == static_cast<int>(events->size()))
+        events->resize(events->size() * 2);
+
+    return numEvent;
+}
+
+/*
+ *  注册监听
+ */
+void EpollPoller::addFd(int fd, uint32_t events)
+{
+    struct epoll_event event;
+    event.events  = events;
+    event.data.fd = fd;
+    epoll_ctl(epollfd_,EPOLL_CTL_ADD, fd, &event);
+}
+
+/*
+ *  修改监听的事件
+ */
+void EpollPoller::modFd(int fd, uint32_t events)
+{
+    struct epoll_event event;
+    event.events  = events;
+    event.data.fd = fd;
+    epoll_ctl(epollfd_,EPOLL_CTL_MOD, fd, &event);
+}
+
+/*
+ *  取消监听
+ */
+void EpollPoller::delFd(int fd)
+{
+    struct epoll_event event;
+    event.events  = 0;
+    event.data.fd = fd;
+    epoll_ctl(epollfd_,EPOLL_CTL_DEL, fd, &event);
+}
@@ -0,0 +1,31 @@
+#ifndef EPOLLPOLLER_H
+#define EPOLLPOLLER_H
+
+#include "Poller.h"
+
+namespace base
+{
+    /*
+     *  基于epoll的Poller
+     * */
+    class EpollPoller : public Poller
+    {
+    public:
+        explicit EpollPoller();
+        ~EpollPoller() override;
+
+        int  poll(int timeoutMs, std::vector<struct epoll_event>* events) override;
+
+        void addFd(int fd, uint32_t events) override;
+        void modFd(int fd, uint32_t events) override;
+        void delFd(int fd) override;
+
+        PollerType getType() override { return kEpoll; }
+        bool isEdgeTriggeredOnly() override { return false; }
+
+    private:
+        int epollfd_; // epoll实例
+    };
+}
+
+#endif //EPOLLPOLLER_H
@@ -5,20 +5,42 @@ using namespace base;
 /*
  *  构造函数
  */
-EventLoop::EventLoop():
-        epollfd_(epoll_create1(EPOLL_CLOEXEC)), /*epoll实例*/
+EventLoop::EventLoop(Poller::PollerType pollerType):
+        running_(false),
+        loopIndex_(0),
+        poller_(Poller::newPoller(pollerType)), /*IO多路复用实例，io_uring不可用时为epoll*/
+        slabPool_(std::make_shared<SlabPool>()), /*内存池*/
+        readArena_(kReadArenaSize), /*共用的读缓冲*/
         curConnection_(nullptr),
-        threadId_(static_cast<pid_t>(::syscall(SYS_gettid))) /*EventLoop对象是在所属的线程被创建的，因此构造时就读取即可*/
+        iterationSeq_(0),
+        iterationStartNs_(0),
+        phase_(kPolling),
+        curConnectionId_(0),
+        threadId_(static_cast<pid_t>(::syscall(SYS_gettid))), /*EventLoop对象是在所属的线程被创建的，因此构造时就读取即可*/
+        listenfd_(-1),
+        idlefd_(-1),
+        maxAcceptsPerWakeup_(0),
+        idleTimeoutTicks_(0),
+        edgeTriggered_(false),
+        polling_(false),
+        wakeupPending_(false),
+        connectionNum_(0),
+        busyTimeUs_(0),
+        wakeupWrites_(0),
+        wakeupElided_(0),
+        connectionsGaugeId_(0)
 {
+    bindMetrics();
+
     // 注册wakeupfd，用于唤醒
     wakeupfd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
-    struct epoll_event event;
-    event.events  = EPOLLIN;
-    event.data.fd = wakeupfd_;
-    epoll_ctl(epollfd_,EPOLL_CTL_ADD, wakeupfd_, &event);
+    poller_->addFd(wakeupfd_, EPOLLIN);
+
+    // 注册timerfd，用于驱动时间轮
+    poller_->addFd(timerWheel_.getFd(), EPOLLIN);
 
-    // 初始化互斥锁
-    pthread_mutex_init(&pendingsMutex_, nullptr);
+    // 只支持边沿触发的Poller，连接必须以ET方式读写
+    edgeTriggered_ = poller_->isEdgeTriggeredOnly();
 }
 
 /// FIXME:和TcpServer谁负责关闭所有Tcp连接？关闭epoll。
@@ -27,15 +49,21 @@ EventLoop::EventLoop():
  */
 EventLoop::~EventLoop()
 {
-    // 销毁互斥锁
-    pthread_mutex_destroy(&pendingsMutex_);
-
     // 注销监听，关闭wakeup
-    struct epoll_event event;
-    event.events  = EPOLLIN;
-    event.data.fd = wakeupfd_;
-    epoll_ctl(epollfd_,EPOLL_CTL_DEL, wakeupfd_, &event);
+    poller_->delFd(wakeupfd_);
     close(wakeupfd_);
+
+    poller_->delFd(timerWheel_.getFd());
+
+    MetricsRegistry::instance().removeGaugeFunc(connectionsGaugeId_);
+
+    // 关闭自己的listen socket
+    if(listenfd_ >= 0)
+    {
+        poller_->delFd(listenfd_);
+        close(listenfd_);
+        close(idlefd_);
+    }
 }
 
 /*
@@ -49,30 +77,39 @@ void EventLoop::loop()
     running_ = true;
 
     const int eventsListInitSize_ = 16; // 初始化events_的大小，如果不够会成倍扩展
-    std::vector<struct epoll_event> events_(eventsListInitSize_); // epoll返回发生的事件结构体
+    std::vector<struct epoll_event> events_(eventsListInitSize_); // Poller返回发生的事件结构体
 
     while(running_)
     {
-        int numEvent = epoll_wait(epollfd_,&(*events_.begin()), events_.size(),-1);
+        // 先声明自己要阻塞了，再检查待办：与wakeup()中“先投递待办，再检查polling_”配对，
+        // 保证要么这里看到了新的待办而不阻塞，要么wakeup()看到polling_为true而写wakeupfd_
+        polling_.store(true, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int timeout = pendings_.empty() ? -1 : 0;
+
+        int numEvent = poller_->poll(timeout, &events_);
+        polling_.store(false, std::memory_order_relaxed);
+        int64_t busyStart = monotonicNanoSeconds();
+
+        // 公布本轮开始，先加轮次再写开始时间，LoopWatchdog前后两次读到同一轮次时，开始时间一定属于这一轮
+        iterationSeq_.store(iterationSeq_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        iterationStartNs_.store(busyStart, std::memory_order_release);
+        phase_.store(kDispatching, std::memory_order_relaxed);
+        metrics_.wakeups_->increment();
+        if(numEvent > 0)
+            metrics_.events_->add(numEvent);
 
         // 如果是stopLoop()唤醒的，就马上退出
         if(!running_)
             break;
 
-        // 异常情况处理
-        if(numEvent == -1 && errno == EINTR)
-            continue;
-        if(numEvent == 0)
-            continue;
-        if(numEvent == events_.size())
-            events_.resize(events_.size() * 2); // 成倍地扩展大小
-
-        // event处理
+        // event处理，没有event（超时返回）时也要往下走去处理待办
         for(int i=0;i < numEvent;++i)
         {
             // 被wakeup
             if(events_[i].data.fd == wakeupfd_)
             {
+                wakeupPending_.store(false, std::memory_order_relaxed);
                 uint64_t one = 1;
                 ssize_t n = ::read(wakeupfd_, &one, sizeof(one)); // 读了就扔掉
                 if (n != sizeof one)
@@ -82,7 +119,28 @@ void EventLoop::loop()
                 continue;
             }
 
-            curConnection_   = connections_[events_[i].data.fd];
+            // 时间轮到期
+            if(events_[i].data.fd == timerWheel_.getFd())
+            {
+                phase_.store(kTimers, std::memory_order_relaxed);
+                timerWheel_.handleRead();
+                phase_.store(kDispatching, std::memory_order_relaxed);
+                continue;
+            }
+
+            // 自己的listen socket上有新连接
+            if(events_[i].data.fd == listenfd_)
+            {
+                handleAccept();
+                continue;
+            }
+
+            // 直接以fd为下标取连接，不做哈希，也不增减引用计数
+            int fd = events_[i].data.fd;
+            curConnection_ = fd < static_cast<int>(connections_.size()) ? connections_[fd].get() : nullptr;
+            if(curConnection_ == nullptr) // 本轮中已经关闭的连接
+                continue;
+            curConnectionId_.store(curConnection_->getId(), std::memory_order_relaxed);
             uint32_t revents = events_[i].events;
 
             // POLLHUP只有在output时才会产生，因此如果只关注了in事件时代表发生error
@@ -111,30 +169,48 @@ void EventLoop::loop()
             }
         }
 
+        curConnection_ = nullptr;
+        curConnectionId_.store(0, std::memory_order_relaxed);
+        int64_t dispatchEnd = monotonicNanoSeconds();
+
         // 处理完event后处理pending
+        phase_.store(kPendingRunning, std::memory_order_relaxed);
         handlePending();
 
-        curConnection_.reset();
+        // 释放本轮中关闭的连接的引用
+        closings_.clear();
+
+        int64_t busyEnd = monotonicNanoSeconds();
+        lagHistograms_[kLagDispatch].record(dispatchEnd - busyStart);
+        lagHistograms_[kLagPending].record(busyEnd - dispatchEnd);
+        lagHistograms_[kLagIteration].record(busyEnd - busyStart);
+        busyTimeUs_.fetch_add((busyEnd - busyStart) / 1000, std::memory_order_relaxed);
+
+        phase_.store(kPolling, std::memory_order_relaxed);
+        iterationStartNs_.store(0, std::memory_order_release);
     }
+
+    // 退出前关闭还属于自己的连接
+    closeAllConnections();
+
+    phase_.store(kPolling, std::memory_order_relaxed);
+    iterationStartNs_.store(0, std::memory_order_release);
 }
 
 /*
  *  处理待办任务
- *  先把pendings_内容取出来，再执行待办，缩小临界区
+ *  只处理进入时已经在队列中的待办，执行待办过程中新增的待办留到下一轮，避免一直占着IO线程
  */
 void EventLoop::handlePending()
 {
-    std::vector<PendingFunc> pendings;
-    pthread_mutex_lock(&pendingsMutex_);
-    pendings.swap(pendings_);
-    pthread_mutex_unlock(&pendingsMutex_);
-
-    for(const PendingFunc& curFunc : pendings)
-        curFunc();
+    size_t num = pendings_.consumeAll([](PendingFunc& curFunc){ curFunc(); });
+    if(num > 0)
+        metrics_.pendings_->add(static_cast<int64_t>(num));
 }
 
 /*
  *  添加TcpConnection对象到列表，并注册监听其fd
+ *  分配好ConnectionId、注册完监听后才回调onConnection，回调中可以用getId()记下连接，也可以直接发送或断开
  */
 void EventLoop::addConnectionInLoop(std::shared_ptr<TcpConnection> connection)
 {
@@ -146,50 +222,323 @@ void EventLoop::addConnectionInLoop(std::shared_ptr<TcpConnection> connection)
 
     // 添加connection到列表
     int fd = connection->getFd();
+    assert(fd < kMaxConnectionFd);
+    if(fd >= static_cast<int>(connections_.size()))
+    {
+        connections_.resize(std::max(static_cast<size_t>(fd + 1), connections_.size() * 2));
+        generations_.resize(connections_.size(), 0);
+        interests_.resize(connections_.size(), 0);
+    }
     connections_[fd] = connection;
 
-    // 注册监听
-    struct epoll_event event;
-    event.events  = EPOLLIN;
-    event.data.fd = fd;
-    epoll_ctl(epollfd_,EPOLL_CTL_ADD, fd, &event);
+    // 分配ConnectionId，generation跳过0，保证ConnectionId不为0
+    if(++generations_[fd] == 0)
+        generations_[fd] = 1;
+    connection->setId(makeConnectionId(loopIndex_, generations_[fd], fd));
+    connectionNum_.fetch_add(1, std::memory_order_relaxed);
+    metrics_.accepts_->increment();
+
+    // 注册监听，ET模式下一直关注可写事件，省去每次发送不完时开关EPOLLOUT的epoll_ctl
+    interests_[fd] = edgeTriggered_ ? (EPOLLIN | EPOLLOUT | EPOLLET) : EPOLLIN;
+    poller_->addFd(fd, interests_[fd]);
+
+    // 空闲连接检测，每个连接只挂一个时间轮定时器，不产生系统调用
+    if(idleTimeoutTicks_ > 0)
+    {
+        connection->setLastActive(timerWheel_.now());
+        connection->setIdleTimer(timerWheel_.runAfterTicks(idleTimeoutTicks_,
+                                 std::bind(&EventLoop::checkIdle,this,std::weak_ptr<TcpConnection>(connection))));
+    }
+
+    // 连接建立时调用回调函数
+    connection->connectEstablished();
+}
+
+/*
+ *  成批添加TcpConnection对象
+ */
+void EventLoop::addConnectionsInLoop(const std::vector<std::shared_ptr<TcpConnection>>& connections)
+{
+    for(const std::shared_ptr<TcpConnection>& connection : connections)
+        addConnectionInLoop(connection);
+}
+
+/*
+ *  设置自己的listen socket，之后由本IO线程直接accept新连接，并在本线程中回调func
+ *  不可跨线程调用，需在loop()前调用
+ */
+void EventLoop::setAcceptor(int listenfd, onNewConnection func, int maxAcceptsPerWakeup)
+{
+    listenfd_        = listenfd;
+    maxAcceptsPerWakeup_ = maxAcceptsPerWakeup;
+    idlefd_          = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+    onNewConnection_ = std::move(func);
+    poller_->addFd(listenfd_, EPOLLIN);
 }
 
 /*
- *  清除TcpConnection对象，并取消监听其fd
+ *  accept新连接，一直accept到EAGAIN，最多maxAcceptsPerWakeup_个
+ *  达到上限时，LT模式下Poller还会再通知；ET模式的Poller不会再通知剩下的连接，要转为待办下一轮接着accept
+ */
+void EventLoop::handleAccept()
+{
+    for(int accepted=0;;++accepted)
+    {
+        if(accepted >= maxAcceptsPerWakeup_)
+        {
+            if(poller_->isEdgeTriggeredOnly())
+                addPending(std::bind(&EventLoop::handleAccept,this));
+            break;
+        }
+
+        struct sockaddr_in peeraddr; // 对等方ip port，网络字节序
+        socklen_t peerlen = sizeof(peeraddr);
+        int connfd = accept4(listenfd_,
+                             (struct sockaddr *)&peeraddr,
+                             &peerlen,
+                             SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if(connfd == -1)
+        {
+            if(errno == EINTR || errno == ECONNABORTED)
+                continue;
+
+            // fd耗尽处理
+            if(errno == EMFILE)
+            {
+                close(idlefd_);
+                idlefd_ = accept(listenfd_, NULL, NULL);
+                close(idlefd_);
+                idlefd_ = open("/dev/null", O_RDONLY | O_CLOEXEC);
+                continue;
+            }
+            break; // EAGAIN，没有更多连接了
+        }
+
+        onNewConnection_(connfd, peeraddr);
+    }
+}
+
+/*
+ *  关闭所有还在监听的连接
+ */
+void EventLoop::closeAllConnections()
+{
+    for(size_t fd=0;fd < connections_.size();++fd)
+    {
+        if(connections_[fd])
+        {
+            std::shared_ptr<TcpConnection> connection = connections_[fd];
+            connection->handleClose();
+        }
+    }
+    closings_.clear();
+}
+
+/*
+ *  空闲连接检测定时器回调
+ *  收到数据时只更新TcpConnection的lastActive_，不动定时器；到期时如果期间有过活动，就按剩余时间重新挂一个定时器，
+ *  否则主动断开连接。用weak_ptr避免定时器延长TcpConnection对象的生命周期；
+ *  连接关闭时addClean()取消定时器，否则weak_ptr会一直留到超时，连同shared_ptr的控制块把连接对象所在的slab内存也占住
+ */
+void EventLoop::checkIdle(std::weak_ptr<TcpConnection> weakConnection)
+{
+    std::shared_ptr<TcpConnection> connection = weakConnection.lock();
+    if(!connection || !connection->isConnected())
+        return;
+
+    int64_t idleTicks = timerWheel_.now() - connection->getLastActive();
+    if(idleTicks >= idleTimeoutTicks_)
+    {
+        connection->handleClose();
+    }
+    else
+    {
+        connection->setIdleTimer(timerWheel_.runAfterTicks(idleTimeoutTicks_ - idleTicks,
+                                 std::bind(&EventLoop::checkIdle,this,std::move(weakConnection))));
+    }
+}
+
+/*
+ *  清除TcpConnection对象，取消监听其fd和空闲连接检测定时器
  */
 void EventLoop::addClean(int fd)
 {
     // 取消监听其fd
-    struct epoll_event event;
-    event.data.fd = fd;
-    event.events  = EPOLLIN;
-    epoll_ctl(epollfd_,EPOLL_CTL_DEL,fd,&event);
+    poller_->delFd(fd);
 
-    // 清除TcpConnection对象
-    connections_.erase(fd);
+    // 清除TcpConnection对象，引用先挪到closings_，本轮循环结束后再释放，避免在TcpConnection自己的成员函数中析构自己
+    if(fd < static_cast<int>(connections_.size()) && connections_[fd])
+    {
+        if(connections_[fd]->getIdleTimer() != 0)
+        {
+            timerWheel_.cancel(connections_[fd]->getIdleTimer());
+            connections_[fd]->setIdleTimer(0);
+        }
+        closings_.push_back(std::move(connections_[fd]));
+        connections_[fd].reset();
+        connectionNum_.fetch_sub(1, std::memory_order_relaxed);
+        metrics_.closes_->increment();
+    }
 }
 
 /*
- *
+ *  由ConnectionId找到连接，O(1)
+ *  连接已经关闭、fd已被新连接复用、或ConnectionId不属于本EventLoop时返回空
+ */
+std::shared_ptr<TcpConnection> EventLoop::getConnection(ConnectionId id)
+{
+    int fd = connectionIdFd(id);
+    if(connectionIdLoop(id) != loopIndex_ || fd >= static_cast<int>(connections_.size()) ||
+       !connections_[fd] || connections_[fd]->getId() != id)
+        return std::shared_ptr<TcpConnection>();
+    return connections_[fd];
+}
+
+/*
+ *  向ConnectionId对应的连接发送消息，连接已经不在了就丢弃
+ */
+void EventLoop::sendToInLoop(ConnectionId id, std::string message)
+{
+    std::shared_ptr<TcpConnection> connection = getConnection(id);
+    if(connection)
+        connection->sendInLoop(std::move(message));
+}
+
+/*
+ *  向一批连接发送同一条消息，每个连接只引用message，不复制
+ *  已经关闭的连接跳过
+ */
+void EventLoop::broadcastInLoop(const std::vector<ConnectionId>& ids, const SharedMessage& message)
+{
+    for(ConnectionId id : ids)
+    {
+        int fd = connectionIdFd(id);
+        if(fd < static_cast<int>(connections_.size()) && connections_[fd] && connections_[fd]->getId() == id)
+            connections_[fd]->sendInLoop(message);
+    }
+}
+
+/*
+ *  关注可写事件
+ *  fd已经注册过，只能MOD；ET模式下一直关注可写事件，无需修改
  */
 void EventLoop::enableEpollOut(int fd)
 {
-    struct epoll_event event;
-    event.events  = EPOLLOUT;
-    event.data.fd = fd;
-    epoll_ctl(epollfd_,EPOLL_CTL_ADD, fd, &event);
+    if(edgeTriggered_)
+        return;
+
+    updateInterest(fd, interests_[fd] | EPOLLOUT);
 }
 
 /*
- *
+ *  取消关注可写事件，保留可读事件的设置
  */
 void EventLoop::disableEpollOut(int fd)
 {
-    struct epoll_event event;
-    event.events  = EPOLLOUT;
-    event.data.fd = fd;
-    epoll_ctl(epollfd_,EPOLL_CTL_DEL, fd, &event);
+    if(edgeTriggered_)
+        return;
+
+    updateInterest(fd, interests_[fd] & ~EPOLLOUT);
+}
+
+/*
+ *  关注可读事件
+ *  ET模式下重新MOD会重新检查一次就绪状态，暂停期间到达的数据也会产生可读事件
+ */
+void EventLoop::enableReading(int fd)
+{
+    updateInterest(fd, interests_[fd] | EPOLLIN);
+}
+
+/*
+ *  取消关注可读事件，数据留在内核接收缓冲区中，由TCP流量控制让对等方慢下来
+ */
+void EventLoop::disableReading(int fd)
+{
+    updateInterest(fd, interests_[fd] & ~EPOLLIN);
+}
+
+/*
+ *  记录因线程池饱和而暂停读的连接，等线程池任务数降到低水位时由resumeThrottledInLoop()恢复
+ */
+void EventLoop::addThrottled(ConnectionId id)
+{
+    throttled_.push_back(id);
+}
+
+/*
+ *  恢复所有因线程池饱和而暂停读的连接，已经关闭的连接直接跳过
+ */
+void EventLoop::resumeThrottledInLoop()
+{
+    std::vector<ConnectionId> throttled;
+    throttled.swap(throttled_);
+    for(ConnectionId id : throttled)
+    {
+        int fd = connectionIdFd(id);
+        if(fd < static_cast<int>(connections_.size()) && connections_[fd] && connections_[fd]->getId() == id)
+            connections_[fd]->unthrottleInLoop();
+    }
+}
+
+/*
+ *  设置在TcpServer的eventLoops_中的下标，按下标重新取指标
+ */
+void EventLoop::setLoopIndex(int index)
+{
+    loopIndex_ = index;
+    bindMetrics();
+}
+
+/*
+ *  阶段名
+ */
+const char* EventLoop::phaseName(int phase)
+{
+    static const char* names[] = { "polling", "dispatching", "timers", "pending" };
+    return phase >= kPolling && phase <= kPendingRunning ? names[phase] : "unknown";
+}
+
+/*
+ *  循环延迟直方图名
+ */
+const char* EventLoop::lagStageName(int stage)
+{
+    static const char* names[kLagStageNum] = { "dispatch", "pending", "iteration" };
+    return stage >= 0 && stage < kLagStageNum ? names[stage] : "unknown";
+}
+
+/*
+ *  从MetricsRegistry取本EventLoop的指标，同一下标的EventLoop（如TcpServer重启后）接着累计
+ */
+void EventLoop::bindMetrics()
+{
+    MetricsRegistry& registry = MetricsRegistry::instance();
+    std::string prefix = "eventloop." + std::to_string(loopIndex_) + ".";
+
+    metrics_.wakeups_      = registry.counter(prefix + "wakeups");
+    metrics_.events_       = registry.counter(prefix + "events");
+    metrics_.pendings_     = registry.counter(prefix + "pendings");
+    metrics_.accepts_      = registry.counter(prefix + "accepts");
+    metrics_.closes_       = registry.counter(prefix + "closes");
+    metrics_.bytesRead_    = registry.counter(prefix + "bytes_read");
+    metrics_.bytesWritten_ = registry.counter(prefix + "bytes_written");
+
+    registry.removeGaugeFunc(connectionsGaugeId_);
+    connectionsGaugeId_ = registry.addGaugeFunc(prefix + "connections",
+                                                std::bind(&EventLoop::getConnectionNum,this));
+}
+
+/*
+ *  修改fd关注的事件，没有变化时不产生系统调用
+ */
+void EventLoop::updateInterest(int fd, uint32_t events)
+{
+    if(interests_[fd] == events)
+        return;
+
+    interests_[fd] = events;
+    poller_->modFd(fd, events);
 }
 
 /****************************************************************************************************************/
@@ -205,15 +554,33 @@ void EventLoop::stopLoop()
 
     running_ = false;
 
-    wakeup();
+    writeWakeupFd(); // 必须真的唤醒，不能被合并
 }
 
 /*
  *  从epoll中唤醒EventLoop
- *  可以往IO线程监听的wakeupfd_中写入触发read event来结束poll()阻塞。
+ *  IO线程醒着（处理event、待办）时不需要唤醒，它在下一次epoll_wait前会检查待办；
+ *  已经有人写过wakeupfd_而IO线程还没读走时也不需要再写，因此一轮循环最多只写一次wakeupfd_。
  */
 void EventLoop::wakeup()
 {
+    std::atomic_thread_fence(std::memory_order_seq_cst); // 与调用者之前对pendings_的push形成全序
+    if(!polling_.load(std::memory_order_relaxed) || wakeupPending_.exchange(true, std::memory_order_acq_rel))
+    {
+        wakeupElided_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    writeWakeupFd();
+}
+
+/*
+ *  往IO线程监听的wakeupfd_中写入，触发read event来结束epoll_wait()阻塞
+ */
+void EventLoop::writeWakeupFd()
+{
+    wakeupWrites_.fetch_add(1, std::memory_order_relaxed);
+
     // 随便写点什么都行
     uint64_t tmp = 1;
     ssize_t n = ::write(wakeupfd_, &tmp, sizeof tmp);
@@ -232,9 +599,7 @@ void EventLoop::wakeup()
  */
 void EventLoop::addPending(PendingFunc func)
 {
-    pthread_mutex_lock(&pendingsMutex_);
-    pendings_.push_back(func);
-    pthread_mutex_unlock(&pendingsMutex_);
+    pendings_.push(std::move(func));
 }
 
 /*
@@ -244,4 +609,41 @@ void EventLoop::addConnection(std::shared_ptr<TcpConnection> connection)
 {
     addPending(std::bind(&EventLoop::addConnectionInLoop,this,std::move(connection)));
     wakeup(); // 添加一个连接比较紧急，需要唤醒IO线程
+}
+
+/*
+ *  成批添加TcpConnection对象，整批只投递一个待办、唤醒一次
+ */
+void EventLoop::addConnections(std::vector<std::shared_ptr<TcpConnection>> connections)
+{
+    addPending(std::bind(&EventLoop::addConnectionsInLoop,this,std::move(connections)));
+    wakeup();
+}
+
+/*
+ *  向ConnectionId对应的连接发送消息
+ *  不需要持有TcpConnection的引用，只要知道ConnectionId，在任意线程都可以发送
+ */
+void EventLoop::sendTo(ConnectionId id, std::string message)
+{
+    addPending(std::bind(&EventLoop::sendToInLoop,this,id,std::move(message)));
+    wakeup();
+}
+
+/*
+ *  恢复因线程池饱和而暂停读的连接，通常由线程池的工作线程在任务数降到低水位时调用
+ */
+void EventLoop::resumeThrottled()
+{
+    addPending(std::bind(&EventLoop::resumeThrottledInLoop,this));
+    wakeup();
+}
+
+/*
+ *  向本EventLoop的一批连接广播同一条消息，整批只投递一个待办、唤醒一次
+ */
+void EventLoop::broadcast(std::vector<ConnectionId> ids, SharedMessage message)
+{
+    addPending(std::bind(&EventLoop::broadcastInLoop,this,std::move(ids),std::move(message)));
+    wakeup();
 }
\ No newline at end of file
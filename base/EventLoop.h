@@ -2,6 +2,12 @@
 #define EVENTLOOP_H
 
 #include "TcpConnection.h"
+#include "TimerWheel.h"
+#include "MpscQueue.h"
+#include "Poller.h"
+#include "SlabPool.h"
+#include "Metrics.h"
+#include "LatencyHistogram.h"
 
 namespace base
 {
@@ -20,39 +26,155 @@ namespace base
     class EventLoop : noncopyable
     {
     public:
+        static const size_t kReadArenaSize = 64 * 1024; // 读缓冲的初始大小，ET模式下一次读多轮时会增长
+
+        // 一轮循环所处的阶段，供LoopWatchdog判断卡在哪里
+        enum LoopPhase{
+            kPolling = 0,     // 阻塞于poll
+            kDispatching,     // 处理就绪事件，curConnection_为正在处理的连接
+            kTimers,          // 执行到期的定时器
+            kPendingRunning   // 执行待办
+        };
+
+        // 循环延迟直方图，每轮记录一次，单位ns
+        enum LagStage{
+            kLagDispatch = 0, // 处理就绪事件（含定时器、accept）的时间
+            kLagPending,      // 执行待办的时间
+            kLagIteration,    // 一轮处理的总时间，即这一轮中其他连接最多要多等的时间
+            kLagStageNum
+        };
+
+        // 本EventLoop的指标，在MetricsRegistry中以“eventloop.<下标>.”为前缀
+        struct LoopMetrics
+        {
+            std::shared_ptr<Counter> wakeups_;      // poll返回的次数
+            std::shared_ptr<Counter> events_;       // 处理的就绪事件数，除以wakeups_即每次唤醒的平均事件数
+            std::shared_ptr<Counter> pendings_;     // 执行的待办数
+            std::shared_ptr<Counter> accepts_;      // 加入本EventLoop的连接数
+            std::shared_ptr<Counter> closes_;       // 关闭的连接数
+            std::shared_ptr<Counter> bytesRead_;    // 从连接读到的字节数
+            std::shared_ptr<Counter> bytesWritten_; // 向连接写出的字节数
+        };
+
         /// 不可跨线程调用
-        explicit EventLoop();
+        explicit EventLoop(Poller::PollerType pollerType = Poller::kEpoll);
         ~EventLoop();
 
         void loop();
         void handlePending();
         void addConnectionInLoop(std::shared_ptr<TcpConnection> connection);
+        void addConnectionsInLoop(const std::vector<std::shared_ptr<TcpConnection>>& connections);
         void addClean(int fd);
+        std::shared_ptr<TcpConnection> getConnection(ConnectionId id);
+        void sendToInLoop(ConnectionId id, std::string message);
+        void broadcastInLoop(const std::vector<ConnectionId>& ids, const SharedMessage& message);
 
         void enableEpollOut(int fd);
         void disableEpollOut(int fd);
+        void enableReading(int fd);
+        void disableReading(int fd);
+        void addThrottled(ConnectionId id);
+        void resumeThrottledInLoop();
+
+        TimerId runAfter(int delayMs, TimerCallback func){ return timerWheel_.runAfter(delayMs, std::move(func)); }
+        TimerId runEvery(int intervalMs, TimerCallback func){ return timerWheel_.runEvery(intervalMs, std::move(func)); }
+        void cancel(TimerId timerId){ timerWheel_.cancel(timerId); }
+        int64_t getTick(){ return timerWheel_.now(); }
+
+        void setAcceptor(int listenfd, onNewConnection func, int maxAcceptsPerWakeup);
+
+        void setLoopIndex(int index); // 需在loop()前调用，写入本EventLoop分配的ConnectionId和指标名
+        int  getLoopIndex(){ return loopIndex_; }
+
+        void setIdleTimeout(int idleSeconds){ idleTimeoutTicks_ = TimerWheel::msToTicks(idleSeconds * 1000); }
+        void setEdgeTriggered(bool on){ edgeTriggered_ = on || poller_->isEdgeTriggeredOnly(); } // 需在loop()前调用
+        Poller::PollerType getPollerType(){ return poller_->getType(); }
+        bool isEdgeTriggered(){ return edgeTriggered_; }
+
+    private:
+        void handleAccept();
+        void closeAllConnections();
+        void checkIdle(std::weak_ptr<TcpConnection> weakConnection);
+        void updateInterest(int fd, uint32_t events);
+        void bindMetrics();
 
+        void writeWakeupFd();
+
+    public:
         /// 可跨线程调用
         void stopLoop();
         void wakeup();
         void addPending(PendingFunc func);
         void addConnection(std::shared_ptr<TcpConnection> connection);
+        void addConnections(std::vector<std::shared_ptr<TcpConnection>> connections);
+        void sendTo(ConnectionId id, std::string message);
+        void broadcast(std::vector<ConnectionId> ids, SharedMessage message);
+        void resumeThrottled();
+
+        int     getConnectionNum(){ return connectionNum_.load(std::memory_order_relaxed); } // 当前连接数
+        int64_t getBusyTimeUs(){ return busyTimeUs_.load(std::memory_order_relaxed); }    // 累计处理event和待办的时间
+
+        std::shared_ptr<SlabPool> getSlabPool(){ return slabPool_; } // 本IO线程的连接、缓冲所用的内存池
+        Buffer* getReadArena(){ return &readArena_; }               // 不可跨线程调用，见TcpConnection::handleRead()
+        LoopMetrics& getMetrics(){ return metrics_; }               // 不可跨线程调用，指标本身可跨线程读取
+
+        int64_t getWakeupWrites(){ return wakeupWrites_.load(std::memory_order_relaxed); } // 实际写wakeupfd_的次数
+        int64_t getWakeupElided(){ return wakeupElided_.load(std::memory_order_relaxed); } // 被合并掉的wakeup次数
+
+        // 本轮处理的状态，供LoopWatchdog读取
+        int64_t      getIterationStartNs(){ return iterationStartNs_.load(std::memory_order_acquire); } // 0表示正阻塞于poll
+        uint64_t     getIterationSeq(){ return iterationSeq_.load(std::memory_order_acquire); }
+        int          getPhase(){ return phase_.load(std::memory_order_relaxed); }
+        ConnectionId getCurrentConnectionId(){ return curConnectionId_.load(std::memory_order_relaxed); }
+        const LatencyHistogram& getLagHistogram(int stage){ return lagHistograms_[stage]; } // 用LatencyHistogram::merge()读取
+
+        static const char* phaseName(int phase);
+        static const char* lagStageName(int stage);
 
 
 
     private:
         bool running_;
         pid_t threadId_; // 所属IO线程的线程ID
+        int loopIndex_;  // 在TcpServer的eventLoops_中的下标
 
         int wakeupfd_; // 用于跨线程唤醒IO线程
-        int epollfd_;  // 监听用的epoll实例
+        std::atomic<bool> polling_;       // IO线程是否正在（或即将）阻塞于epoll_wait，为false时说明IO线程醒着，不需要唤醒
+        std::atomic<bool> wakeupPending_; // 已经写过wakeupfd_但IO线程还没读走，此时不需要再写
+        std::atomic<int>     connectionNum_; // 连接数，供TcpServer选择IO线程时跨线程读取
+        std::atomic<int64_t> busyTimeUs_;    // 累计忙碌时间（不含阻塞于poll的时间）
+        std::atomic<int64_t> wakeupWrites_;
+        std::atomic<int64_t> wakeupElided_;
+        std::unique_ptr<Poller> poller_; // IO多路复用实例
+        std::shared_ptr<SlabPool> slabPool_; // 内存池，TcpConnection对象及其缓冲从这里分配
+        Buffer readArena_; // 本IO线程所有连接共用的读缓冲，onMessage直接在其中解析，只有没处理完的尾部才复制到连接自己的缓冲
+        LoopMetrics metrics_;     // 指标
+        int connectionsGaugeId_;  // 当前连接数在MetricsRegistry中的登记号
+
+        TcpConnection* curConnection_; // 当前正在处理的发生event的Connection，不持有引用，由closings_保证其在本轮循环内有效
+
+        std::atomic<uint64_t>     iterationSeq_;     // 轮次，每轮处理开始时加1
+        std::atomic<int64_t>      iterationStartNs_; // 本轮处理的开始时间，阻塞于poll时为0
+        std::atomic<int>          phase_;            // 本轮所处的阶段，见LoopPhase
+        std::atomic<ConnectionId> curConnectionId_;  // curConnection_的ConnectionId，供其他线程读取
+        LatencyHistogram lagHistograms_[kLagStageNum]; // 循环延迟，只有IO线程写
+
+        MpscQueue<PendingFunc> pendings_; // 待办列表，无锁，任意线程都可以投递，只有IO线程消费
 
-        std::shared_ptr<TcpConnection> curConnection_; // 当前正在处理的发生event的Connection
+        std::vector<std::shared_ptr<TcpConnection>> connections_; // 监听的TcpConnection列表，以fd为下标，空位为nullptr
+        std::vector<uint32_t> generations_;                        // 各fd最近一次分配的ConnectionId的generation
+        std::vector<uint32_t> interests_;                          // 各fd当前向Poller注册的事件，没有变化时不MOD
+        std::vector<ConnectionId> throttled_;                      // 因线程池饱和而暂停读的连接
+        std::vector<std::shared_ptr<TcpConnection>> closings_;    // 本轮循环中关闭的TcpConnection，循环末尾再释放引用
 
-        std::vector<PendingFunc> pendings_; // 待办列表
-        pthread_mutex_t pendingsMutex_;     // 待办列表的互斥锁
+        int listenfd_;                    // 自己accept时的listen socket，-1表示没有
+        int idlefd_;                      // 占一个位置，以防fd耗尽
+        int maxAcceptsPerWakeup_;         // 每次listen socket可读时最多accept的连接数
+        onNewConnection onNewConnection_; // accept到新连接时的回调
 
-        std::unordered_map<int,std::shared_ptr<TcpConnection>> connections_; // 监听的TcpConnection列表，K-V -> fd-pointer
+        TimerWheel timerWheel_;    // 定时器
+        int64_t idleTimeoutTicks_; // 空闲连接超时的tick数，0表示不检测
+        bool edgeTriggered_;       // 连接是否以EPOLLET注册，此时TcpConnection需要一直读/写到EAGAIN
     };
 }
 
@@ -0,0 +1,386 @@
+#include "IoUringPoller.h"
+
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+
+using namespace base;
+
+/*
+ *  构造函数
+ *  创建io_uring并映射SQ、CQ环，再探测内核是否支持multishot poll；失败时ringfd_为-1，由Poller::newPoller()退回epoll
+ */
+IoUringPoller::IoUringPoller(unsigned entries):
+        ringfd_(-1),
+        features_(0),
+        sqRing_(MAP_FAILED),
+        sqRingSize_(0),
+        sqes_(static_cast<struct io_uring_sqe*>(MAP_FAILED)),
+        sqesSize_(0),
+        sqLocalTail_(0),
+        unsubmitted_(0),
+        cqRing_(MAP_FAILED),
+        cqRingSize_(0)
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof params);
+    params.flags      = IORING_SETUP_CQSIZE;
+    params.cq_entries = entries * kCqMultiple; // 每个fd至多同时有一个未取走的CQE，CQ给大一些，减少溢出
+
+    int fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+    if(fd < 0) // 内核不支持或被禁用
+        return;
+
+    sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    bool singleMmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if(singleMmap)
+        sqRingSize_ = cqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+
+    sqRing_ = ::mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if(sqRing_ == MAP_FAILED)
+    {
+        close(fd);
+        return;
+    }
+    cqRing_ = singleMmap ? sqRing_ :
+              ::mmap(nullptr, cqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    sqesSize_ = params.sq_entries * sizeof(struct io_uring_sqe);
+    sqes_ = static_cast<struct io_uring_sqe*>(
+            ::mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+    if(cqRing_ == MAP_FAILED || sqes_ == MAP_FAILED)
+    {
+        if(sqes_ != MAP_FAILED)
+            ::munmap(sqes_, sqesSize_);
+        if(cqRing_ != MAP_FAILED && cqRing_ != sqRing_)
+            ::munmap(cqRing_, cqRingSize_);
+        ::munmap(sqRing_, sqRingSize_);
+        sqRing_ = cqRing_ = MAP_FAILED;
+        sqes_   = static_cast<struct io_uring_sqe*>(MAP_FAILED);
+        close(fd);
+        return;
+    }
+
+    char* sq = static_cast<char*>(sqRing_);
+    sqHead_    = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sqTail_    = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sqMask_    = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sqEntries_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_entries);
+    sqArray_   = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    sqLocalTail_ = *sqTail_;
+
+    // SQ的下标数组固定为恒等映射，第i个SQE就放在sqes_[i]
+    for(unsigned i=0;i < sqEntries_;++i)
+        sqArray_[i] = i;
+
+    char* cq = static_cast<char*>(cqRing_);
+    cqHead_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cqTail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cqMask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes_   = reinterpret_cast<struct io_uring_cqe*>(cq + params.cq_off.cqes);
+
+    features_ = params.features;
+    ringfd_   = fd;
+
+    // 5.5~5.12的内核能创建带CQSIZE的io_uring，但不认识IORING_POLL_ADD_MULTI，每个连接都会收到出错的CQE
+    if(!probeMultishotPoll())
+        closeRing();
+}
+
+/*
+ *  析构函数
+ */
+IoUringPoller::~IoUringPoller()
+{
+    closeRing();
+}
+
+/*
+ *  提交积攒的SQE并等待、收割CQE
+ *  CQ中已有CQE或timeoutMs为0时不阻塞
+ */
+int IoUringPoller::poll(int timeoutMs, std::vector<struct epoll_event>* events)
+{
+    // 先提交上一轮SQ放不下的SQE，还有剩下时不阻塞，收割完CQE尽快回来接着提交
+    while(!overflow_.empty())
+    {
+        flushOverflow();
+        if(enter(unsubmitted_, 0, 0) <= 0)
+            break;
+    }
+
+    bool hasCqe = *cqHead_ != __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+    unsigned minComplete = (timeoutMs != 0 && !hasCqe && overflow_.empty()) ? 1 : 0;
+    if(unsubmitted_ > 0 || minComplete > 0)
+        enter(unsubmitted_, minComplete, timeoutMs);
+
+    int numEvent  = 0;
+    unsigned head = *cqHead_;
+    unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+    for(;head != tail;++head)
+    {
+        const struct io_uring_cqe* cqe = &cqes_[head & cqMask_];
+        uint64_t userData = cqe->user_data;
+        if(userData == 0) // POLL_REMOVE自身、构造时探测用的poll的完成通知
+            continue;
+
+        int fd = static_cast<int>(userData & 0xffffffff);
+        uint32_t generation = static_cast<uint32_t>(userData >> 32);
+        if(fd >= static_cast<int>(masks_.size()) || masks_[fd] == 0 || generations_[fd] != generation)
+            continue; // 已经注销或修改过的旧poll
+
+        uint32_t revents;
+        if(cqe->res >= 0)
+        {
+            revents = static_cast<uint32_t>(cqe->res);
+            // multishot被内核终止（例如CQ溢出），重新提交一个
+            if(!(cqe->flags & IORING_CQE_F_MORE))
+                prepPollAdd(fd, masks_[fd]);
+        }
+        else
+        {
+            revents = EPOLLERR; // poll本身出错，交给连接按错误处理
+        }
+
+        if(numEvent == static_cast<int>(events->size()))
+            events->resize(events->size() * 2);
+        (*events)[numEvent].events  = revents;
+        (*events)[numEvent].data.fd = fd;
+        ++numEvent;
+    }
+    __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+
+    return numEvent;
+}
+
+/*
+ *  注册监听
+ */
+void IoUringPoller::addFd(int fd, uint32_t events)
+{
+    ensureFdSlot(fd);
+    if(masks_[fd] != 0)
+    {
+        modFd(fd, events);
+        return;
+    }
+
+    ++generations_[fd];
+    masks_[fd] = events;
+    prepPollAdd(fd, events);
+}
+
+/*
+ *  修改监听的事件：撤销旧poll，换新generation再提交新poll
+ */
+void IoUringPoller::modFd(int fd, uint32_t events)
+{
+    ensureFdSlot(fd);
+    if(masks_[fd] == events)
+        return;
+    if(masks_[fd] == 0)
+    {
+        addFd(fd, events);
+        return;
+    }
+
+    prepPollRemove(fd);
+    ++generations_[fd];
+    masks_[fd] = events;
+    prepPollAdd(fd, events);
+}
+
+/*
+ *  取消监听
+ *  只是填写POLL_REMOVE，调用者随后close(fd)也没关系：io_uring持有file的引用，poll会在下次提交时被撤销
+ */
+void IoUringPoller::delFd(int fd)
+{
+    if(fd >= static_cast<int>(masks_.size()) || masks_[fd] == 0)
+        return;
+
+    prepPollRemove(fd);
+    ++generations_[fd];
+    masks_[fd] = 0;
+}
+
+/****************************************************************************************************************/
+
+/*
+ *  探测内核是否支持multishot poll
+ *  对一个已可读的eventfd提交multishot POLL_ADD，等它的CQE：成功且带IORING_CQE_F_MORE才算支持，随后撤销这个poll
+ *  探测用的SQE、CQE的user_data都为0，poll()收到剩下的CQE时会跳过
+ */
+bool IoUringPoller::probeMultishotPoll()
+{
+    int efd = ::eventfd(1, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(efd < 0)
+        return false;
+
+    struct io_uring_sqe sqe;
+    memset(&sqe, 0, sizeof sqe);
+    sqe.opcode        = IORING_OP_POLL_ADD;
+    sqe.fd            = efd;
+    sqe.poll32_events = EPOLLIN;
+    sqe.len           = IORING_POLL_ADD_MULTI;
+    sqe.user_data     = 0;
+    pushSqe(sqe);
+
+    int ret;
+    do
+    {
+        ret = enter(unsubmitted_, 1, -1);
+    } while(ret < 0 && errno == EINTR);
+
+    bool supported = false;
+    if(ret >= 0)
+    {
+        unsigned head = *cqHead_;
+        if(head != __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE))
+        {
+            const struct io_uring_cqe* cqe = &cqes_[head & cqMask_];
+            supported = cqe->res > 0 && (cqe->flags & IORING_CQE_F_MORE);
+            __atomic_store_n(cqHead_, head + 1, __ATOMIC_RELEASE);
+        }
+    }
+
+    if(supported)
+    {
+        memset(&sqe, 0, sizeof sqe);
+        sqe.opcode    = IORING_OP_POLL_REMOVE;
+        sqe.fd        = -1;
+        sqe.addr      = 0;
+        sqe.user_data = 0;
+        pushSqe(sqe);
+        enter(unsubmitted_, 0, 0);
+    }
+    close(efd);
+    return supported;
+}
+
+/*
+ *  撤销映射并关闭io_uring
+ */
+void IoUringPoller::closeRing()
+{
+    if(ringfd_ < 0)
+        return;
+
+    ::munmap(sqes_, sqesSize_);
+    if(cqRing_ != sqRing_)
+        ::munmap(cqRing_, cqRingSize_);
+    ::munmap(sqRing_, sqRingSize_);
+    close(ringfd_);
+    ringfd_ = -1;
+}
+
+/*
+ *  把一个SQE放入SQ并发布到尾部，SQ满了就先提交一次
+ *  提交出错或只提交了一部分，SQ仍然是满的，就暂存到overflow_，等下一次poll()再提交；
+ *  已经有暂存的SQE时也排在它们后面，保证同一个fd的POLL_REMOVE、POLL_ADD按顺序提交
+ */
+void IoUringPoller::pushSqe(const struct io_uring_sqe& sqe)
+{
+    if(overflow_.empty() && isSqFull())
+        enter(unsubmitted_, 0, 0);
+    if(!overflow_.empty() || isSqFull())
+    {
+        overflow_.push_back(sqe);
+        return;
+    }
+
+    sqes_[sqLocalTail_ & sqMask_] = sqe;
+    ++sqLocalTail_;
+    ++unsubmitted_;
+    __atomic_store_n(sqTail_, sqLocalTail_, __ATOMIC_RELEASE);
+}
+
+/*
+ *  把overflow_中的SQE按顺序放入SQ，放到SQ满为止
+ */
+void IoUringPoller::flushOverflow()
+{
+    size_t moved = 0;
+    while(moved < overflow_.size() && !isSqFull())
+    {
+        sqes_[sqLocalTail_ & sqMask_] = overflow_[moved++];
+        ++sqLocalTail_;
+        ++unsubmitted_;
+    }
+    __atomic_store_n(sqTail_, sqLocalTail_, __ATOMIC_RELEASE);
+    overflow_.erase(overflow_.begin(), overflow_.begin() + moved);
+}
+
+/*
+ *  填写一个multishot POLL_ADD
+ */
+void IoUringPoller::prepPollAdd(int fd, uint32_t events)
+{
+    struct io_uring_sqe sqe;
+    memset(&sqe, 0, sizeof sqe);
+    sqe.opcode        = IORING_OP_POLL_ADD;
+    sqe.fd            = fd;
+    sqe.poll32_events = events & ~static_cast<uint32_t>(EPOLLET); // io_uring的poll本来就是边沿触发
+    sqe.len           = IORING_POLL_ADD_MULTI;
+    sqe.user_data     = makeUserData(fd);
+    pushSqe(sqe);
+}
+
+/*
+ *  填写一个POLL_REMOVE，撤销fd当前generation的poll
+ */
+void IoUringPoller::prepPollRemove(int fd)
+{
+    struct io_uring_sqe sqe;
+    memset(&sqe, 0, sizeof sqe);
+    sqe.opcode    = IORING_OP_POLL_REMOVE;
+    sqe.fd        = -1;
+    sqe.addr      = makeUserData(fd);
+    sqe.user_data = 0;
+    pushSqe(sqe);
+}
+
+/*
+ *  调用io_uring_enter提交SQE，minComplete大于0时等待完成事件
+ *  timeoutMs大于0且内核支持EXT_ARG时带超时等待
+ */
+int IoUringPoller::enter(unsigned toSubmit, unsigned minComplete, int timeoutMs)
+{
+    unsigned flags = minComplete > 0 ? IORING_ENTER_GETEVENTS : 0;
+    int ret;
+
+    if(minComplete > 0 && timeoutMs > 0 && (features_ & IORING_FEAT_EXT_ARG))
+    {
+        struct __kernel_timespec ts;
+        ts.tv_sec  = timeoutMs / 1000;
+        ts.tv_nsec = (timeoutMs % 1000) * 1000 * 1000;
+
+        struct io_uring_getevents_arg arg;
+        memset(&arg, 0, sizeof arg);
+        arg.ts = reinterpret_cast<uint64_t>(&ts);
+
+        ret = static_cast<int>(::syscall(__NR_io_uring_enter, ringfd_, toSubmit, minComplete,
+                                         flags | IORING_ENTER_EXT_ARG, &arg, sizeof arg));
+    }
+    else
+    {
+        ret = static_cast<int>(::syscall(__NR_io_uring_enter, ringfd_, toSubmit, minComplete,
+                                         flags, nullptr, 0));
+    }
+
+    if(ret > 0)
+        unsubmitted_ -= std::min(unsubmitted_, static_cast<unsigned>(ret));
+    return ret;
+}
+
+/*
+ *  保证masks_、generations_能以fd为下标访问
+ */
+void IoUringPoller::ensureFdSlot(int fd)
+{
+    if(fd < static_cast<int>(masks_.size()))
+        return;
+
+    size_t newSize = std::max(static_cast<size_t>(fd + 1), masks_.size() * 2);
+    masks_.resize(newSize, 0);
+    generations_.resize(newSize, 0);
+}
@@ -0,0 +1,86 @@
+#ifndef IOURINGPOLLER_H
+#define IOURINGPOLLER_H
+
+#include <linux/io_uring.h>
+
+#include "Poller.h"
+
+namespace base
+{
+    /*
+     *  基于io_uring的Poller，直接使用系统调用，不依赖liburing
+     *  每个fd提交一个multishot POLL_ADD，fd就绪时内核往完成队列（CQ）投递一个CQE，poll()把CQE转换成epoll_event。
+     *  注册、修改、注销只是往提交队列（SQ）中填SQE，留到下一次poll()时和等待一起用一次io_uring_enter()提交，
+     *  因此一轮循环无论改了多少fd的监听都只有一次系统调用。
+     *
+     *  multishot poll只在fd状态变化时投递CQE，相当于epoll的ET模式，所以isEdgeTriggeredOnly()为true。
+     *  user_data由fd和generation组成，fd注销时generation加1，之后收到的旧CQE一律丢弃，避免fd复用时误投递。
+     *
+     *  multishot poll要5.13以上的内核，更早的内核能创建io_uring，但POLL_ADD一律失败。
+     *  构造时对一个eventfd提交一次multishot POLL_ADD探测，不支持时isValid()为false，由Poller::newPoller()退回epoll。
+     *  SQ满了又提交不出去时，SQE暂存在overflow_中，下一次poll()时再提交，不会覆盖还没被内核取走的SQE。
+     * */
+    class IoUringPoller : public Poller
+    {
+    public:
+        explicit IoUringPoller(unsigned entries = kDefaultEntries);
+        ~IoUringPoller() override;
+
+        bool isValid(){ return ringfd_ >= 0; } // 创建io_uring失败或内核不支持multishot poll时为false
+
+        int  poll(int timeoutMs, std::vector<struct epoll_event>* events) override;
+
+        void addFd(int fd, uint32_t events) override;
+        void modFd(int fd, uint32_t events) override;
+        void delFd(int fd) override;
+
+        PollerType getType() override { return kIoUring; }
+        bool isEdgeTriggeredOnly() override { return true; }
+
+    private:
+        static const unsigned kDefaultEntries = 256; // SQ大小，CQ为其kCqMultiple倍
+        static const unsigned kCqMultiple     = 16;
+
+        bool probeMultishotPoll();
+        void closeRing();
+        bool isSqFull(){ return sqLocalTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE) >= sqEntries_; }
+        void pushSqe(const struct io_uring_sqe& sqe);
+        void flushOverflow();
+        void prepPollAdd(int fd, uint32_t events);
+        void prepPollRemove(int fd);
+        int  enter(unsigned toSubmit, unsigned minComplete, int timeoutMs);
+        uint64_t makeUserData(int fd){ return (static_cast<uint64_t>(generations_[fd]) << 32) | static_cast<uint32_t>(fd); }
+        void ensureFdSlot(int fd);
+
+    private:
+        int ringfd_;      // io_uring实例
+        unsigned features_;
+
+        // SQ环
+        void*     sqRing_;
+        size_t    sqRingSize_;
+        unsigned* sqHead_;
+        unsigned* sqTail_;
+        unsigned  sqMask_;
+        unsigned  sqEntries_;
+        unsigned* sqArray_;
+        struct io_uring_sqe* sqes_;
+        size_t    sqesSize_;
+        unsigned  sqLocalTail_; // 已填写的SQE的尾部
+        unsigned  unsubmitted_; // 已填写但还没提交的SQE数量
+        std::vector<struct io_uring_sqe> overflow_; // SQ满了放不下的SQE，按顺序等下一次poll()提交
+
+        // CQ环
+        void*     cqRing_;
+        size_t    cqRingSize_;
+        unsigned* cqHead_;
+        unsigned* cqTail_;
+        unsigned  cqMask_;
+        struct io_uring_cqe* cqes_;
+
+        std::vector<uint32_t> masks_;       // 各fd当前监听的事件，0表示未注册
+        std::vector<uint32_t> generations_; // 各fd的generation
+    };
+}
+
+#endif //IOURINGPOLLER_H
@@ -0,0 +1,267 @@
+#include "LatencyHistogram.h"
+
+#include <algorithm>
+#include <stdio.h>
+
+using namespace base;
+
+std::atomic<bool> LatencyRegistry::enabled_(false);
+
+/*
+ *  构造函数
+ */
+LatencyHistogram::LatencyHistogram()
+{
+    reset();
+}
+
+/*
+ *  记录一个值
+ *  唯一的写线程调用，不需要原子RMW
+ */
+void LatencyHistogram::record(int64_t ns)
+{
+    if(ns < 0)
+        ns = 0;
+
+    std::atomic<int64_t>& bucket = buckets_[bucketIndex(ns)];
+    bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    count_.store(count_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    sum_.store(sum_.load(std::memory_order_relaxed) + ns, std::memory_order_relaxed);
+    if(ns > max_.load(std::memory_order_relaxed))
+        max_.store(ns, std::memory_order_relaxed);
+}
+
+/*
+ *  把other的计数加到自己身上
+ */
+void LatencyHistogram::merge(const LatencyHistogram& other)
+{
+    for(int i=0;i < kBucketNum;++i)
+    {
+        int64_t n = other.buckets_[i].load(std::memory_order_relaxed);
+        if(n != 0)
+            buckets_[i].store(buckets_[i].load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+    count_.store(count_.load(std::memory_order_relaxed) + other.count(), std::memory_order_relaxed);
+    sum_.store(sum_.load(std::memory_order_relaxed) + other.sum_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    if(other.max() > max())
+        max_.store(other.max(), std::memory_order_relaxed);
+}
+
+/*
+ *  清空
+ */
+void LatencyHistogram::reset()
+{
+    for(int i=0;i < kBucketNum;++i)
+        buckets_[i].store(0, std::memory_order_relaxed);
+    count_.store(0, std::memory_order_relaxed);
+    sum_.store(0, std::memory_order_relaxed);
+    max_.store(0, std::memory_order_relaxed);
+}
+
+/*
+ *  平均值
+ */
+int64_t LatencyHistogram::mean() const
+{
+    int64_t n = count();
+    return n > 0 ? sum_.load(std::memory_order_relaxed) / n : 0;
+}
+
+/*
+ *  分位值
+ *  从小到大累加各桶的计数，返回累计数达到count*percent/100的桶的上界
+ */
+int64_t LatencyHistogram::percentile(double percent) const
+{
+    int64_t total = count();
+    if(total == 0)
+        return 0;
+
+    int64_t target = static_cast<int64_t>(total * percent / 100.0 + 0.5);
+    if(target < 1)
+        target = 1;
+
+    int64_t seen = 0;
+    for(int i=0;i < kBucketNum;++i)
+    {
+        seen += buckets_[i].load(std::memory_order_relaxed);
+        if(seen >= target)
+            return std::min(bucketUpperBound(i), max());
+    }
+    return max();
+}
+
+/*
+ *  值所在的桶
+ */
+int LatencyHistogram::bucketIndex(int64_t ns)
+{
+    uint64_t value = static_cast<uint64_t>(ns);
+    if(value < static_cast<uint64_t>(kSubBuckets))
+        return static_cast<int>(value);
+
+    int exponent = 63 - __builtin_clzll(value); // 最高位，至少为kSubBucketBits
+    if(exponent > kMaxExponent)
+        return kBucketNum - 1;
+
+    int shift = exponent - kSubBucketBits;
+    int sub   = static_cast<int>((value >> shift) & (kSubBuckets - 1));
+    return (shift + 1) * kSubBuckets + sub;
+}
+
+/*
+ *  桶中最大的值
+ */
+int64_t LatencyHistogram::bucketUpperBound(int index)
+{
+    if(index < kSubBuckets)
+        return index;
+
+    int shift = index / kSubBuckets - 1;
+    int sub   = index % kSubBuckets;
+    int64_t lower = static_cast<int64_t>(kSubBuckets + sub) << shift;
+    return lower + (static_cast<int64_t>(1) << shift) - 1;
+}
+
+/****************************************************************************************************************/
+
+/*
+ *  全局唯一的注册表
+ *  不析构，线程退出时还要把计数并入其中
+ */
+LatencyRegistry& LatencyRegistry::instance()
+{
+    static LatencyRegistry* registry = new LatencyRegistry;
+    return *registry;
+}
+
+/*
+ *  阶段名
+ */
+const char* LatencyRegistry::stageName(int stage)
+{
+    static const char* names[kStageNum] = {
+        "on_message", "pool_queue", "task_run", "send_pending", "output_queue", "end_to_end"
+    };
+    return stage >= 0 && stage < kStageNum ? names[stage] : "unknown";
+}
+
+/*
+ *  构造函数
+ */
+LatencyRegistry::LatencyRegistry()
+{
+    pthread_mutex_init(&mutex_, nullptr);
+}
+
+/*
+ *  析构函数
+ */
+LatencyRegistry::~LatencyRegistry()
+{
+    pthread_mutex_destroy(&mutex_);
+}
+
+/*
+ *  记入当前线程的直方图
+ */
+void LatencyRegistry::record(Stage stage, int64_t ns)
+{
+    localHistograms()->stages_[stage].record(ns);
+}
+
+/*
+ *  当前线程的直方图，第一次调用时创建并登记，线程退出时注销
+ */
+LatencyRegistry::ThreadHistograms* LatencyRegistry::localHistograms()
+{
+    static thread_local std::unique_ptr<ThreadHistograms> local;
+    if(!local)
+    {
+        local.reset(new ThreadHistograms);
+        local->tid_ = static_cast<pid_t>(::syscall(SYS_gettid));
+
+        LatencyRegistry& registry = instance();
+        pthread_mutex_lock(&registry.mutex_);
+        registry.threads_.push_back(local.get());
+        pthread_mutex_unlock(&registry.mutex_);
+    }
+    return local.get();
+}
+
+/*
+ *  线程退出时，把计数并入retired_并注销
+ */
+LatencyRegistry::ThreadHistograms::~ThreadHistograms()
+{
+    LatencyRegistry& registry = instance();
+    pthread_mutex_lock(&registry.mutex_);
+    for(int i=0;i < kStageNum;++i)
+        registry.retired_[i].merge(stages_[i]);
+    registry.threads_.erase(std::remove(registry.threads_.begin(), registry.threads_.end(), this),
+                            registry.threads_.end());
+    pthread_mutex_unlock(&registry.mutex_);
+}
+
+/*
+ *  所有线程（包括已退出的）同一阶段合并后的直方图
+ */
+void LatencyRegistry::snapshot(int stage, LatencyHistogram* result)
+{
+    pthread_mutex_lock(&mutex_);
+    result->merge(retired_[stage]);
+    for(ThreadHistograms* thread : threads_)
+        result->merge(thread->stages_[stage]);
+    pthread_mutex_unlock(&mutex_);
+}
+
+/*
+ *  文本报告，perThread为true时在全局视图后再列出每个线程的各阶段
+ */
+std::string LatencyRegistry::report(bool perThread)
+{
+    std::string text;
+    for(int i=0;i < kStageNum;++i)
+    {
+        LatencyHistogram merged;
+        snapshot(i, &merged);
+        text += formatLine(stageName(i), merged);
+    }
+
+    if(perThread)
+    {
+        pthread_mutex_lock(&mutex_);
+        for(ThreadHistograms* thread : threads_)
+        {
+            for(int i=0;i < kStageNum;++i)
+            {
+                if(thread->stages_[i].count() == 0)
+                    continue;
+                std::string name = "tid" + std::to_string(thread->tid_) + "." + stageName(i);
+                text += formatLine(name.c_str(), thread->stages_[i]);
+            }
+        }
+        pthread_mutex_unlock(&mutex_);
+    }
+    return text;
+}
+
+/*
+ *  一行报告，时间单位为us
+ */
+std::string LatencyRegistry::formatLine(const char* name, const LatencyHistogram& histogram)
+{
+    char line[256];
+    snprintf(line, sizeof line, "%-24s count=%lld mean=%.1f p50=%.1f p99=%.1f p999=%.1f max=%.1f\n",
+             name,
+             static_cast<long long>(histogram.count()),
+             histogram.mean() / 1000.0,
+             histogram.percentile(50) / 1000.0,
+             histogram.percentile(99) / 1000.0,
+             histogram.percentile(99.9) / 1000.0,
+             histogram.max() / 1000.0);
+    return line;
+}
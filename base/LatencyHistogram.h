@@ -0,0 +1,118 @@
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include "noncopyable.h"
+#include "Types.h"
+
+namespace base
+{
+    /*
+     *  对数分桶的延迟直方图（HDR风格），单位ns
+     *  小于kSubBuckets的值每个值一个桶；更大的值按2的幂分段，每段再等分为kSubBuckets个桶，
+     *  因此任何值的相对误差不超过1/kSubBuckets（12.5%），覆盖到2^kMaxExponent ns（约18分钟），超出的计入最后一个桶。
+     *
+     *  只有一个线程调用record()（见LatencyRegistry，每个线程每个阶段一个直方图），
+     *  各计数用relaxed的load+store更新，没有原子RMW；其他线程可以随时merge()读取，读到的是近似一致的值。
+     * */
+    class LatencyHistogram : noncopyable
+    {
+    public:
+        static const int kSubBucketBits = 3;
+        static const int kSubBuckets    = 1 << kSubBucketBits;
+        static const int kMaxExponent   = 40;
+        static const int kBucketNum     = (kMaxExponent - kSubBucketBits + 1) * kSubBuckets + kSubBuckets;
+
+        explicit LatencyHistogram();
+
+        /// 不可跨线程调用，只能由唯一的写线程调用
+        void record(int64_t ns);
+
+        /// 可跨线程调用
+        void merge(const LatencyHistogram& other); // 把other的计数加到自己身上，自己不能同时被record()
+        void reset();
+
+        int64_t count() const { return count_.load(std::memory_order_relaxed); }
+        int64_t max() const   { return max_.load(std::memory_order_relaxed); }
+        int64_t mean() const;
+        int64_t percentile(double percent) const; // percent为0~100，返回该分位所在桶的上界（不超过max）
+
+        static int     bucketIndex(int64_t ns);
+        static int64_t bucketUpperBound(int index);
+
+    private:
+        std::atomic<int64_t> buckets_[kBucketNum];
+        std::atomic<int64_t> count_;
+        std::atomic<int64_t> sum_;
+        std::atomic<int64_t> max_;
+    };
+
+    /*
+     *  各处理阶段的延迟统计
+     *  每个线程第一次record()时创建自己的一组直方图（每个阶段一个）并登记，之后只写自己的，不加锁；
+     *  线程退出时把自己的计数并入retired_后注销。snapshot()把所有线程的同一阶段合并成全局视图。
+     *
+     *  一条消息的读取时间通过线程局部的“当前读取时间”在各阶段之间传递：
+     *  TcpConnection::handleRead()在调用onMessage前设置，ThreadPool/Strand投递任务时记下、执行任务时恢复，
+     *  TcpConnection::send()转为待办时记下、在IO线程中发送时恢复，最终写出时得到端到端延迟。
+     *  统计默认关闭，关闭时各处只多一次relaxed读。
+     * */
+    class LatencyRegistry : noncopyable
+    {
+    public:
+        // 处理阶段
+        enum Stage{
+            kOnMessage = 0, // 读到数据 -> onMessage返回
+            kPoolQueue,     // 任务投递 -> 开始执行（含Strand中的排队）
+            kTaskRun,       // 任务执行时间
+            kSendPending,   // TcpConnection::send() -> IO线程中执行sendInLoop()
+            kOutputQueue,   // 一次没写完的数据进入输出缓冲 -> 输出缓冲写空
+            kEndToEnd,      // 读到数据 -> 应答全部写入socket
+            kStageNum
+        };
+
+        static LatencyRegistry& instance();
+        static const char* stageName(int stage);
+
+        /// 可跨线程调用
+        static void setEnabled(bool on){ enabled_.store(on, std::memory_order_relaxed); }
+        static bool isEnabled(){ return enabled_.load(std::memory_order_relaxed); }
+
+        static void record(Stage stage, int64_t ns); // 记入当前线程的直方图
+
+        void snapshot(int stage, LatencyHistogram* result); // 所有线程合并后的直方图，result需为空
+        std::string report(bool perThread = false);         // 每行一个阶段：次数、均值、p50、p99、p999、最大值（us）
+
+        static std::string formatLine(const char* name, const LatencyHistogram& histogram); // report()中的一行
+
+        // 当前线程正在处理的消息的读取时间（ns），0表示没有
+        static int64_t& currentReadTime()
+        {
+            static thread_local int64_t readTime = 0;
+            return readTime;
+        }
+
+    private:
+        // 一个线程的各阶段直方图
+        struct ThreadHistograms
+        {
+            ~ThreadHistograms();
+
+            pid_t tid_;
+            LatencyHistogram stages_[kStageNum];
+        };
+
+        explicit LatencyRegistry();
+        ~LatencyRegistry();
+
+        static ThreadHistograms* localHistograms();
+
+    private:
+        static std::atomic<bool> enabled_;
+
+        pthread_mutex_t mutex_;
+        std::vector<ThreadHistograms*> threads_; // 还在运行的线程
+        LatencyHistogram retired_[kStageNum];    // 已退出线程的计数
+    };
+}
+
+#endif //LATENCYHISTOGRAM_H
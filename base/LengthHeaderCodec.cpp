@@ -0,0 +1,78 @@
+#include "LengthHeaderCodec.h"
+
+using namespace base;
+
+/*
+ *  构造函数
+ */
+LengthHeaderCodec::LengthHeaderCodec(onFrame onFrameFunc, int32_t maxFrameSize)
+        : onFrame_(std::move(onFrameFunc)),
+          maxFrameSize_(maxFrameSize)
+{
+}
+
+/*
+ *  解码，作为TcpServer的onMessage回调，在IO线程中执行
+ *  逐条取出完整的消息交给onFrame_，StringPiece直接指向Buffer中的数据
+ */
+void LengthHeaderCodec::onMessage(const std::shared_ptr<TcpConnection> conn, Buffer* buffer, struct sockaddr_in peeraddr)
+{
+    while(buffer->readableBytes() >= kHeaderLen && conn->isConnected())
+    {
+        const int32_t len = buffer->peekInt32();
+        if(len < 0 || len > maxFrameSize_) // 长度非法，数据已经无法分帧
+        {
+            buffer->retrieveAll();
+            conn->handleClose();
+            break;
+        }
+
+        if(buffer->readableBytes() < kHeaderLen + static_cast<size_t>(len)) // 还不是完整的一条
+            break;
+
+        onFrame_(conn, StringPiece(buffer->peek() + kHeaderLen, len), peeraddr);
+        buffer->retrieve(kHeaderLen + len);
+    }
+}
+
+/*
+ *  在IO线程中发送message中的全部数据作为一条消息
+ *  长度写在prepend区，发送时不复制
+ */
+void LengthHeaderCodec::sendInLoop(const std::shared_ptr<TcpConnection>& conn, Buffer* message)
+{
+    encode(message);
+    conn->sendInLoop(message->peek(), message->readableBytes());
+    message->retrieveAll();
+}
+
+/*
+ *  发送一条消息，任意线程都可以调用
+ *  长度和消息拼成一个SharedMessage，只复制一次
+ */
+void LengthHeaderCodec::send(const std::shared_ptr<TcpConnection>& conn, StringPiece message)
+{
+    conn->send(encodeShared(message));
+}
+
+/*
+ *  在Buffer中已有的数据前面写上长度
+ */
+void LengthHeaderCodec::encode(Buffer* message)
+{
+    assert(message->prependableBytes() >= kHeaderLen);
+    message->prependInt32(static_cast<int32_t>(message->readableBytes()));
+}
+
+/*
+ *  编码成一个可以发给多个连接的SharedMessage
+ */
+SharedMessage LengthHeaderCodec::encodeShared(StringPiece message)
+{
+    std::string frame;
+    frame.reserve(kHeaderLen + message.size());
+    int32_t be32 = htobe32(static_cast<int32_t>(message.size()));
+    frame.append(reinterpret_cast<const char*>(&be32), sizeof be32);
+    frame.append(message.data(), message.size());
+    return std::make_shared<const std::string>(std::move(frame));
+}
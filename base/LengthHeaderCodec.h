@@ -0,0 +1,49 @@
+#ifndef LENGTHHEADERCODEC_H
+#define LENGTHHEADERCODEC_H
+
+#include "noncopyable.h"
+#include "StringPiece.h"
+#include "TcpConnection.h"
+
+namespace base
+{
+    using onFrame = std::function<void(const std::shared_ptr<TcpConnection>&,
+                                       StringPiece,
+                                       struct sockaddr_in)>; // 收到一条完整消息的回调
+
+    /*
+     *  长度前缀消息编解码器
+     *  每条消息前面是4字节网络字节序的消息长度（不含这4字节本身）。
+     *
+     *  解码：把onMessage()作为TcpServer的onMessage回调，它在Buffer中原地找出完整的消息，
+     *  以StringPiece的形式交给onFrame回调，不复制数据；StringPiece只在回调期间有效，需要保存时自己复制。
+     *  不完整的消息留在Buffer中等下次数据到来。消息长度为负或超过maxFrameSize时认为对方出错，断开连接。
+     *
+     *  编码：encode()把长度写到Buffer的prepend区（kCheapPrepend），不移动消息本身。
+     * */
+    class LengthHeaderCodec : noncopyable
+    {
+    public:
+        static const size_t  kHeaderLen = sizeof(int32_t);
+        static const int32_t kDefaultMaxFrameSize = 16 * 1024 * 1024;
+
+        explicit LengthHeaderCodec(onFrame onFrameFunc, int32_t maxFrameSize = kDefaultMaxFrameSize);
+
+        /// 不可跨线程调用
+        void onMessage(const std::shared_ptr<TcpConnection> conn, Buffer* buffer, struct sockaddr_in peeraddr);
+
+        void sendInLoop(const std::shared_ptr<TcpConnection>& conn, Buffer* message);
+
+        /// 可跨线程调用
+        void send(const std::shared_ptr<TcpConnection>& conn, StringPiece message);
+
+        static void encode(Buffer* message);
+        static SharedMessage encodeShared(StringPiece message);
+
+    private:
+        onFrame onFrame_;
+        int32_t maxFrameSize_;
+    };
+}
+
+#endif //LENGTHHEADERCODEC_H
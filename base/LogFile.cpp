@@ -0,0 +1,94 @@
+#include "LogFile.h"
+
+using namespace base;
+
+/*
+ *  构造函数，马上打开第一个文件
+ */
+LogFile::LogFile(const std::string& basename, off_t rollSize)
+        :
+        basename_(basename),
+        rollSize_(rollSize),
+        fp_(nullptr),
+        writtenBytes_(0),
+        startOfPeriod_(0),
+        rollCount_(0)
+{
+    rollFile();
+}
+
+/*
+ *  析构函数
+ */
+LogFile::~LogFile()
+{
+    if(fp_)
+        fclose(fp_);
+}
+
+/*
+ *  写入一批日志，超过文件大小上限或跨天时换文件
+ *  一批日志不拆到两个文件中，因此单个文件可能略超过rollSize_
+ */
+void LogFile::append(const char* data, size_t len)
+{
+    if(fp_ == nullptr)
+        return;
+
+    size_t written = 0;
+    while(written < len)
+    {
+        size_t n = fwrite_unlocked(data + written, 1, len - written, fp_);
+        if(n == 0)
+            break; /// FIXME:写文件出错（如磁盘满），这批日志剩下的部分丢弃
+        written += n;
+    }
+    writtenBytes_ += static_cast<off_t>(written);
+
+    if(writtenBytes_ > rollSize_ || time(nullptr) / kRollPerSeconds * kRollPerSeconds != startOfPeriod_)
+        rollFile();
+}
+
+/*
+ *  把缓冲写入文件
+ */
+void LogFile::flush()
+{
+    if(fp_)
+        fflush(fp_);
+}
+
+/****************************************************************************************************************/
+
+/*
+ *  关闭当前文件，打开一个新文件
+ */
+void LogFile::rollFile()
+{
+    time_t now = time(nullptr);
+
+    if(fp_)
+        fclose(fp_);
+
+    fp_ = fopen(makeFileName(now).c_str(), "ae"); // 追加，O_CLOEXEC
+    if(fp_)
+        setbuffer(fp_, buffer_, sizeof buffer_);
+
+    writtenBytes_  = 0;
+    startOfPeriod_ = now / kRollPerSeconds * kRollPerSeconds;
+    ++rollCount_;
+}
+
+/*
+ *  文件名：basename.20261017-120000.1234.log
+ */
+std::string LogFile::makeFileName(time_t now)
+{
+    struct tm tmTime;
+    localtime_r(&now, &tmTime);
+
+    char timeString[32];
+    strftime(timeString, sizeof timeString, ".%Y%m%d-%H%M%S.", &tmTime);
+
+    return basename_ + timeString + std::to_string(::getpid()) + ".log";
+}
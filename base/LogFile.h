@@ -0,0 +1,45 @@
+#ifndef LOGFILE_H
+#define LOGFILE_H
+
+#include "noncopyable.h"
+#include "Types.h"
+
+#include <stdio.h>
+
+namespace base
+{
+    /*
+     *  滚动日志文件
+     *  文件名为 basename.日期-时间.pid.log，写满rollSize字节或跨天时换一个新文件。
+     *  只由AsyncLogging的后台线程使用，不加锁，用fwrite_unlocked()写入自带的大缓冲。
+     * */
+    class LogFile : noncopyable
+    {
+    public:
+        static const int kRollPerSeconds = 24 * 3600; // 至少每天换一个文件
+
+        /// 不可跨线程调用
+        explicit LogFile(const std::string& basename, off_t rollSize);
+        ~LogFile();
+
+        void append(const char* data, size_t len);
+        void flush();
+
+        int getRollCount(){ return rollCount_; } // 已经打开过的文件数
+
+    private:
+        void rollFile();
+        std::string makeFileName(time_t now);
+
+    private:
+        std::string basename_;
+        off_t       rollSize_;      // 单个文件的字节数上限
+        FILE*       fp_;
+        off_t       writtenBytes_;  // 当前文件已写字节数
+        time_t      startOfPeriod_; // 当前文件所属的那一天（0点的时间）
+        int         rollCount_;
+        char        buffer_[64 * 1024]; // fp_的用户态缓冲
+    };
+}
+
+#endif //LOGFILE_H
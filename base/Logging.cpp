@@ -0,0 +1,193 @@
+#include "Logging.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace base;
+
+std::atomic<int>   Logger::level_(Logger::kInfo);
+Logger::OutputFunc Logger::output_;
+Logger::FlushFunc  Logger::flush_;
+
+/*
+ *  整数转为十进制
+ *  从低位往高位写到临时数组，再整体追加
+ */
+template<typename T>
+void LogStream::formatInteger(T v)
+{
+    char buf[32];
+    char* end = buf + sizeof buf;
+    char* p   = end;
+
+    // 负数逐位取余得到的是负的余数，用绝对值查表，不对v取负，避免最小值溢出
+    static const char digits[] = "9876543210123456789";
+    const char* zero = digits + 9;
+    T i = v;
+    do
+    {
+        int lsd = static_cast<int>(i % 10);
+        i /= 10;
+        *--p = zero[lsd];
+    } while(i != 0);
+
+    if(v < 0)
+        *--p = '-';
+
+    append(p, static_cast<size_t>(end - p));
+}
+
+// 定义在.cpp中，显式实例化operator<<用到的各整数类型
+template void LogStream::formatInteger(int);
+template void LogStream::formatInteger(unsigned int);
+template void LogStream::formatInteger(long);
+template void LogStream::formatInteger(unsigned long);
+template void LogStream::formatInteger(long long);
+template void LogStream::formatInteger(unsigned long long);
+
+/*
+ *  指针以十六进制输出
+ */
+LogStream& LogStream::operator<<(const void* p)
+{
+    char buf[32];
+    int n = snprintf(buf, sizeof buf, "%p", p);
+    append(buf, static_cast<size_t>(n));
+    return *this;
+}
+
+/*
+ *  浮点数，最多12位有效数字
+ */
+LogStream& LogStream::operator<<(double v)
+{
+    char buf[32];
+    int n = snprintf(buf, sizeof buf, "%.12g", v);
+    append(buf, static_cast<size_t>(n));
+    return *this;
+}
+
+/****************************************************************************************************************/
+
+/*
+ *  级别名，定长，日志中各列对齐
+ */
+const char* Logger::levelName(int level)
+{
+    static const char* names[kNumLevels] = { "TRACE ", "DEBUG ", "INFO  ", "WARN  ", "ERROR ", "FATAL " };
+    return level >= 0 && level < kNumLevels ? names[level] : "UNKNOW";
+}
+
+/*
+ *  输出一条日志，没有设置输出函数时同步写stdout
+ */
+void Logger::output(const char* data, size_t len)
+{
+    if(output_)
+        output_(data, len);
+    else
+        fwrite(data, 1, len, stdout);
+}
+
+/*
+ *  刷新输出
+ */
+void Logger::flush()
+{
+    if(flush_)
+        flush_();
+    else
+        fflush(stdout);
+}
+
+/*
+ *  设置输出函数，传入空函数时恢复为stdout
+ */
+void Logger::setOutput(OutputFunc func)
+{
+    output_ = std::move(func);
+}
+
+/*
+ *  设置刷新函数，FATAL日志abort()前调用
+ */
+void Logger::setFlush(FlushFunc func)
+{
+    flush_ = std::move(func);
+}
+
+/****************************************************************************************************************/
+
+/*
+ *  构造函数
+ *  格式：日期 时间.微秒 线程ID 级别 正文 - 源文件:行号
+ */
+LogLine::LogLine(Logger::LogLevel level, const char* file, int line)
+        :
+        level_(level),
+        file_(file),
+        line_(line)
+{
+    const char* slash = strrchr(file, '/');
+    if(slash)
+        file_ = slash + 1;
+
+    formatTime();
+
+    // 线程ID只在每个线程第一次写日志时格式化
+    static thread_local char tidString[16];
+    static thread_local int  tidLength = 0;
+    if(tidLength == 0)
+        tidLength = snprintf(tidString, sizeof tidString, "%5d ", static_cast<int>(::syscall(SYS_gettid)));
+    stream_.append(tidString, static_cast<size_t>(tidLength));
+
+    stream_.append(Logger::levelName(level_), 6);
+}
+
+/*
+ *  析构函数
+ *  补上源文件位置，整条交给Logger::output()；FATAL日志刷新后abort()
+ */
+LogLine::~LogLine()
+{
+    // 正文写满时截掉一段，保证源文件位置和换行写得下
+    const size_t kTailReserve = 128;
+    if(stream_.avail() < kTailReserve)
+        stream_.truncate(LogStream::kBufferSize - kTailReserve);
+
+    stream_ << " - " << file_ << ':' << line_ << '\n';
+    Logger::output(stream_.data(), stream_.length());
+
+    if(level_ == Logger::kFatal)
+    {
+        Logger::flush();
+        abort();
+    }
+}
+
+/*
+ *  写入时间
+ *  秒以上的部分每个线程缓存一份，秒数变化时才重新localtime_r()
+ */
+void LogLine::formatTime()
+{
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+
+    static thread_local time_t lastSecond = 0;
+    static thread_local char   secondString[32];
+    if(tv.tv_sec != lastSecond)
+    {
+        lastSecond = tv.tv_sec;
+        struct tm tmTime;
+        localtime_r(&tv.tv_sec, &tmTime);
+        snprintf(secondString, sizeof secondString, "%4d%02d%02d %02d:%02d:%02d",
+                 tmTime.tm_year + 1900, tmTime.tm_mon + 1, tmTime.tm_mday,
+                 tmTime.tm_hour, tmTime.tm_min, tmTime.tm_sec);
+    }
+
+    char microString[16];
+    int n = snprintf(microString, sizeof microString, ".%06d ", static_cast<int>(tv.tv_usec));
+    stream_.append(secondString, 17);
+    stream_.append(microString, static_cast<size_t>(n));
+}
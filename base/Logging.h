@@ -0,0 +1,141 @@
+#ifndef LOGGING_H
+#define LOGGING_H
+
+#include "noncopyable.h"
+#include "Types.h"
+
+// 编译期日志级别，低于该级别的LOG_*整条语句（包括<<右边的表达式）都被编译器删去
+// 0:TRACE 1:DEBUG 2:INFO 3:WARN 4:ERROR 5:FATAL，如-DBASE_LOG_LEVEL=2去掉所有TRACE、DEBUG日志
+#ifndef BASE_LOG_LEVEL
+#define BASE_LOG_LEVEL 1
+#endif
+
+namespace base
+{
+    /*
+     *  一条日志的格式化缓冲
+     *  定长数组，在栈上，写满后截断；整数自己转换，不经过snprintf
+     * */
+    class LogStream : noncopyable
+    {
+    public:
+        static const int kBufferSize = 4000;
+
+        explicit LogStream(): cur_(data_){}
+
+        LogStream& operator<<(bool v){ append(v ? "1" : "0", 1); return *this; }
+        LogStream& operator<<(short v){ return *this << static_cast<int>(v); }
+        LogStream& operator<<(unsigned short v){ return *this << static_cast<unsigned int>(v); }
+        LogStream& operator<<(int v){ formatInteger(v); return *this; }
+        LogStream& operator<<(unsigned int v){ formatInteger(v); return *this; }
+        LogStream& operator<<(long v){ formatInteger(v); return *this; }
+        LogStream& operator<<(unsigned long v){ formatInteger(v); return *this; }
+        LogStream& operator<<(long long v){ formatInteger(v); return *this; }
+        LogStream& operator<<(unsigned long long v){ formatInteger(v); return *this; }
+        LogStream& operator<<(const void* p);
+        LogStream& operator<<(double v);
+        LogStream& operator<<(char c){ append(&c, 1); return *this; }
+        LogStream& operator<<(const char* str){ if(str) append(str, strlen(str)); else append("(null)", 6); return *this; }
+        LogStream& operator<<(const std::string& str){ append(str.data(), str.size()); return *this; }
+
+        void append(const char* data, size_t len)
+        {
+            if(len > avail())
+                len = avail();
+            memcpy(cur_, data, len);
+            cur_ += len;
+        }
+
+        void truncate(size_t len){ if(len < length()) cur_ = data_ + len; }
+
+        const char* data() const { return data_; }
+        size_t length() const { return static_cast<size_t>(cur_ - data_); }
+        size_t avail() const { return static_cast<size_t>(data_ + sizeof data_ - cur_); }
+
+    private:
+        template<typename T>
+        void formatInteger(T v);
+
+    private:
+        char  data_[kBufferSize];
+        char* cur_;
+    };
+
+    /*
+     *  日志全局设置
+     *  运行期级别低于level_的日志只多一次relaxed读；
+     *  日志默认同步写到stdout，setOutput()可换成AsyncLogging::append()等，需在其他线程开始写日志前调用。
+     * */
+    class Logger : noncopyable
+    {
+    public:
+        enum LogLevel{
+            kTrace = 0,
+            kDebug,
+            kInfo,
+            kWarn,
+            kError,
+            kFatal, // 写完后flush并abort()
+            kNumLevels
+        };
+
+        using OutputFunc = std::function<void(const char*, size_t)>; // 输出一条完整的日志
+        using FlushFunc  = std::function<void()>;
+
+        /// 可跨线程调用
+        static void setLevel(LogLevel level){ level_.store(level, std::memory_order_relaxed); }
+        static LogLevel getLevel(){ return static_cast<LogLevel>(level_.load(std::memory_order_relaxed)); }
+        static bool isEnabled(LogLevel level){ return level >= level_.load(std::memory_order_relaxed); }
+        static const char* levelName(int level);
+
+        static void output(const char* data, size_t len);
+        static void flush();
+
+        /// 不可跨线程调用
+        static void setOutput(OutputFunc func);
+        static void setFlush(FlushFunc func);
+
+    private:
+        static std::atomic<int> level_;
+        static OutputFunc output_;
+        static FlushFunc  flush_;
+    };
+
+    /*
+     *  一条日志，由LOG_*宏在栈上构造
+     *  构造时写入时间、线程ID、级别，析构时补上源文件位置和换行，整条交给Logger::output()；
+     *  时间的秒以上部分、线程ID在线程局部缓存，同一秒内只格式化微秒部分。
+     * */
+    class LogLine : noncopyable
+    {
+    public:
+        explicit LogLine(Logger::LogLevel level, const char* file, int line);
+        ~LogLine();
+
+        LogStream& stream(){ return stream_; }
+
+    private:
+        void formatTime();
+
+    private:
+        Logger::LogLevel level_;
+        const char*      file_; // 源文件名，不含路径
+        int              line_;
+        LogStream        stream_;
+    };
+}
+
+// 编译期级别以下的宏条件为常量，整条语句被删去；否则再按运行期级别判断
+// 写成if-else的形式，避免宏用在没有花括号的if中时else配错
+#define BASE_LOG_IF(level, compiledIn) \
+    if(!(compiledIn) || !base::Logger::isEnabled(level)) {} \
+    else base::LogLine(level, __FILE__, __LINE__).stream()
+
+#define LOG_TRACE BASE_LOG_IF(base::Logger::kTrace, BASE_LOG_LEVEL <= 0)
+#define LOG_DEBUG BASE_LOG_IF(base::Logger::kDebug, BASE_LOG_LEVEL <= 1)
+#define LOG_INFO  BASE_LOG_IF(base::Logger::kInfo,  BASE_LOG_LEVEL <= 2)
+#define LOG_WARN  BASE_LOG_IF(base::Logger::kWarn,  BASE_LOG_LEVEL <= 3)
+#define LOG_ERROR BASE_LOG_IF(base::Logger::kError, BASE_LOG_LEVEL <= 4)
+#define LOG_FATAL base::LogLine(base::Logger::kFatal, __FILE__, __LINE__).stream()
+
+#endif //LOGGING_H
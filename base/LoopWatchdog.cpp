@@ -0,0 +1,149 @@
+#include "LoopWatchdog.h"
+#include "Logging.h"
+
+#include <algorithm>
+
+using namespace base;
+
+/*
+ *  构造函数
+ *  thresholdMs至少为1，检查周期为其1/4，因此卡顿最迟在1.25倍阈值时被发现
+ */
+LoopWatchdog::LoopWatchdog(int thresholdMs, onLoopStall func)
+        :
+        thresholdNs_(static_cast<int64_t>(std::max(thresholdMs, 1)) * 1000 * 1000), /*卡顿阈值*/
+        intervalMs_(std::max(thresholdMs / 4, 1)), /*检查周期*/
+        onLoopStall_(std::move(func)),
+        thread_(std::bind(&LoopWatchdog::watchLoops,this,std::placeholders::_1)), /*看门狗线程*/
+        running_(false)
+{
+    pthread_mutex_init(&mutex_, nullptr);
+
+    // stop()后要马上醒来，用单调时钟计算超时，不受系统时间调整影响
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&cond_, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+/*
+ *  析构函数
+ */
+LoopWatchdog::~LoopWatchdog()
+{
+    stop();
+
+    pthread_mutex_destroy(&mutex_);
+    pthread_cond_destroy(&cond_);
+}
+
+/*
+ *  开始检查loops，之后每个周期检查一次
+ *  可重复调用，已在运行时直接返回
+ */
+void LoopWatchdog::start(const std::vector<std::shared_ptr<EventLoop>>& loops)
+{
+    pthread_mutex_lock(&mutex_);
+    if(running_)
+    {
+        pthread_mutex_unlock(&mutex_);
+        return;
+    }
+
+    loops_ = loops;
+    reportedSeqs_.assign(loops_.size(), 0);
+    stalls_.clear();
+    for(const std::shared_ptr<EventLoop>& loop : loops_)
+        stalls_.push_back(MetricsRegistry::instance().counter("eventloop." + std::to_string(loop->getLoopIndex()) + ".stalls"));
+
+    running_ = true;
+    pthread_mutex_unlock(&mutex_);
+
+    thread_.startThread();
+}
+
+/*
+ *  停止看门狗线程，等其退出后释放对各EventLoop的引用
+ *  可重复调用
+ */
+void LoopWatchdog::stop()
+{
+    pthread_mutex_lock(&mutex_);
+    if(!running_)
+    {
+        pthread_mutex_unlock(&mutex_);
+        return;
+    }
+    running_ = false;
+    pthread_cond_signal(&cond_);
+    pthread_mutex_unlock(&mutex_);
+
+    thread_.joinThread();
+    loops_.clear();
+}
+
+/****************************************************************************************************************/
+
+/*
+ *  看门狗线程函数
+ *  每隔intervalMs_检查一次，stop()时马上退出
+ */
+void* LoopWatchdog::watchLoops(void* data)
+{
+    pthread_mutex_lock(&mutex_);
+    while(running_)
+    {
+        struct timespec deadline;
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec  += intervalMs_ / 1000;
+        deadline.tv_nsec += static_cast<long>(intervalMs_ % 1000) * 1000 * 1000;
+        if(deadline.tv_nsec >= 1000 * 1000 * 1000)
+        {
+            deadline.tv_sec  += 1;
+            deadline.tv_nsec -= 1000 * 1000 * 1000;
+        }
+        pthread_cond_timedwait(&cond_, &mutex_, &deadline);
+        if(!running_)
+            break;
+
+        // 检查时不持锁，回调中可以调用stop()以外的任何接口
+        pthread_mutex_unlock(&mutex_);
+        checkLoops();
+        pthread_mutex_lock(&mutex_);
+    }
+    pthread_mutex_unlock(&mutex_);
+
+    return nullptr;
+}
+
+/*
+ *  检查各EventLoop的本轮处理是否超过阈值
+ *  先后两次读轮次，不一致说明读的过程中IO线程进入了下一轮，这次不作判断
+ */
+void LoopWatchdog::checkLoops()
+{
+    for(size_t i=0;i < loops_.size();++i)
+    {
+        EventLoop* loop = loops_[i].get();
+
+        uint64_t     seq     = loop->getIterationSeq();
+        int64_t      startNs = loop->getIterationStartNs();
+        int          phase   = loop->getPhase();
+        ConnectionId id      = loop->getCurrentConnectionId();
+        if(startNs == 0 || seq != loop->getIterationSeq() || seq == reportedSeqs_[i])
+            continue;
+
+        int64_t stalledNs = monotonicNanoSeconds() - startNs;
+        if(stalledNs < thresholdNs_)
+            continue;
+
+        reportedSeqs_[i] = seq;
+        stalls_[i]->increment();
+        if(onLoopStall_)
+            onLoopStall_(loop->getLoopIndex(), phase, id, stalledNs / (1000 * 1000));
+        else
+            LOG_WARN << "eventloop " << loop->getLoopIndex() << " stalled " << stalledNs / (1000 * 1000)
+                     << "ms in " << EventLoop::phaseName(phase) << ", connection fd " << (id ? connectionIdFd(id) : -1);
+    }
+}
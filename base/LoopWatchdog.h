@@ -0,0 +1,53 @@
+#ifndef LOOPWATCHDOG_H
+#define LOOPWATCHDOG_H
+
+#include "noncopyable.h"
+#include "Thread.h"
+#include "EventLoop.h"
+
+namespace base
+{
+    /*
+     *  EventLoop卡顿检测
+     *  一个onMessage回调或一批待办执行得太久，同一个EventLoop上的所有连接都得不到处理。
+     *  EventLoop在每轮处理开始时公布开始时间、轮次、所处阶段和正在处理的连接（见EventLoop::loop()），阻塞于poll时开始时间为0；
+     *  看门狗线程每隔threshold/4醒来一次，发现某个EventLoop的本轮处理超过threshold时，计入“eventloop.<下标>.stalls”并回调onLoopStall_（没有设置时写一条WARN日志），
+     *  同一轮只报告一次。回调在看门狗线程中执行，此时IO线程仍卡在原处，回调里不能等待该IO线程。
+     *
+     *  看门狗只读EventLoop公布的原子变量，不加锁，不影响IO线程；
+     *  持有各EventLoop的引用，必须在TcpServer释放eventLoops_之前stop()。
+     * */
+    class LoopWatchdog : noncopyable
+    {
+    public:
+        /// 可跨线程调用
+        explicit LoopWatchdog(int thresholdMs, onLoopStall func);
+        ~LoopWatchdog();
+
+        void start(const std::vector<std::shared_ptr<EventLoop>>& loops);
+        void stop();
+
+        int getThresholdMs(){ return static_cast<int>(thresholdNs_ / (1000 * 1000)); }
+
+    private:
+        /// 不可跨线程调用
+        void* watchLoops(void* data);
+        void checkLoops();
+
+    private:
+        int64_t     thresholdNs_; // 一轮处理超过这么久视为卡顿
+        int         intervalMs_;  // 检查周期
+        onLoopStall onLoopStall_; // 卡顿回调，在看门狗线程中执行
+
+        std::vector<std::shared_ptr<EventLoop>> loops_;  // 被检查的EventLoop
+        std::vector<uint64_t>                 reportedSeqs_; // 各EventLoop最近一次报告过的轮次，同一轮只报告一次
+        std::vector<std::shared_ptr<Counter>> stalls_;       // 各EventLoop的卡顿次数
+
+        Thread          thread_;  // 看门狗线程
+        bool            running_;
+        pthread_mutex_t mutex_;
+        pthread_cond_t  cond_;    // stop()时唤醒看门狗线程
+    };
+}
+
+#endif //LOOPWATCHDOG_H
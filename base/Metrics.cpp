@@ -0,0 +1,153 @@
+#include "Metrics.h"
+
+#include <algorithm>
+
+using namespace base;
+
+/*
+ *  构造函数
+ */
+ShardedValue::ShardedValue()
+{
+    for(int i=0;i < kShards;++i)
+        cells_[i].value_.store(0, std::memory_order_relaxed);
+}
+
+/*
+ *  所有分片之和
+ */
+int64_t ShardedValue::value() const
+{
+    int64_t sum = 0;
+    for(int i=0;i < kShards;++i)
+        sum += cells_[i].value_.load(std::memory_order_relaxed);
+    return sum;
+}
+
+/*
+ *  给新线程分配分片下标，轮流分配
+ */
+int ShardedValue::nextShard()
+{
+    static std::atomic<int> next(0);
+    return next.fetch_add(1, std::memory_order_relaxed) % kShards;
+}
+
+/****************************************************************************************************************/
+
+/*
+ *  全局唯一的注册表
+ *  不析构，避免进程退出时其他线程还在更新或登记指标
+ */
+MetricsRegistry& MetricsRegistry::instance()
+{
+    static MetricsRegistry* registry = new MetricsRegistry;
+    return *registry;
+}
+
+/*
+ *  构造函数
+ */
+MetricsRegistry::MetricsRegistry()
+    :nextGaugeFuncId_(1)
+{
+    pthread_mutex_init(&mutex_, nullptr);
+}
+
+/*
+ *  析构函数
+ */
+MetricsRegistry::~MetricsRegistry()
+{
+    pthread_mutex_destroy(&mutex_);
+}
+
+/*
+ *  取名为name的Counter，没有就新建
+ */
+std::shared_ptr<Counter> MetricsRegistry::counter(const std::string& name)
+{
+    pthread_mutex_lock(&mutex_);
+    std::shared_ptr<Counter>& counter = counters_[name];
+    if(!counter)
+        counter = std::make_shared<Counter>();
+    std::shared_ptr<Counter> result = counter;
+    pthread_mutex_unlock(&mutex_);
+    return result;
+}
+
+/*
+ *  取名为name的Gauge，没有就新建
+ */
+std::shared_ptr<Gauge> MetricsRegistry::gauge(const std::string& name)
+{
+    pthread_mutex_lock(&mutex_);
+    std::shared_ptr<Gauge>& gauge = gauges_[name];
+    if(!gauge)
+        gauge = std::make_shared<Gauge>();
+    std::shared_ptr<Gauge> result = gauge;
+    pthread_mutex_unlock(&mutex_);
+    return result;
+}
+
+/*
+ *  登记一个取快照时才调用的读取函数
+ *  func通常bind了某个对象，该对象析构前必须removeGaugeFunc()
+ */
+int MetricsRegistry::addGaugeFunc(const std::string& name, GaugeFunc func)
+{
+    pthread_mutex_lock(&mutex_);
+    int id = nextGaugeFuncId_++;
+    gaugeFuncs_[id] = std::make_pair(name, std::move(func));
+    pthread_mutex_unlock(&mutex_);
+    return id;
+}
+
+/*
+ *  注销读取函数，返回后不会再被调用
+ */
+void MetricsRegistry::removeGaugeFunc(int id)
+{
+    pthread_mutex_lock(&mutex_);
+    gaugeFuncs_.erase(id);
+    pthread_mutex_unlock(&mutex_);
+}
+
+/*
+ *  取所有指标的当前值
+ *  各分片分别读取，不是同一时刻的精确值，但每个计数本身不会丢失
+ */
+std::vector<MetricsRegistry::Sample> MetricsRegistry::snapshot()
+{
+    std::vector<Sample> samples;
+
+    pthread_mutex_lock(&mutex_);
+    samples.reserve(counters_.size() + gauges_.size() + gaugeFuncs_.size());
+    for(const auto& item : counters_)
+        samples.push_back(Sample{item.first, item.second->value()});
+    for(const auto& item : gauges_)
+        samples.push_back(Sample{item.first, item.second->value()});
+    for(const auto& item : gaugeFuncs_)
+        samples.push_back(Sample{item.second.first, item.second.second()});
+    pthread_mutex_unlock(&mutex_);
+
+    std::sort(samples.begin(), samples.end(),
+              [](const Sample& a, const Sample& b){ return a.name_ < b.name_; });
+    return samples;
+}
+
+/*
+ *  以文本形式取快照，每行一个“名字 值”
+ */
+std::string MetricsRegistry::snapshotText()
+{
+    std::string text;
+    for(const Sample& sample : snapshot())
+    {
+        text += sample.name_;
+        text += ' ';
+        text += std::to_string(sample.value_);
+        text += '\n';
+    }
+    return text;
+}
@@ -0,0 +1,104 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include "noncopyable.h"
+#include "Types.h"
+
+#include <map>
+
+namespace base
+{
+    /*
+     *  按线程分片的计数
+     *  每个线程第一次使用时分到一个分片下标，之后只改自己的分片，各分片独占一个cache line，线程之间不会抢同一行；
+     *  线程数超过kShards时才会有线程共用分片，因此写分片仍用原子加，但几乎不会有竞争。
+     *  读取时把所有分片加起来，只在取快照时发生。
+     *  所有接口都可跨线程调用。
+     * */
+    class ShardedValue : noncopyable
+    {
+    public:
+        static const int kShards = 16;
+
+        explicit ShardedValue();
+
+        void add(int64_t n){ cells_[shardIndex()].value_.fetch_add(n, std::memory_order_relaxed); }
+        int64_t value() const;
+
+    private:
+        struct Cell
+        {
+            std::atomic<int64_t> value_;
+            char pad_[64 - sizeof(std::atomic<int64_t>)]; // 每个分片独占一个cache line，避免伪共享
+        };
+
+        static int shardIndex()
+        {
+            static thread_local int index = nextShard();
+            return index;
+        }
+        static int nextShard();
+
+    private:
+        Cell cells_[kShards];
+    };
+
+    // 只增不减的计数，如收到的字节数
+    class Counter : public ShardedValue
+    {
+    public:
+        void increment(){ add(1); }
+    };
+
+    // 可增可减的计量，如当前连接数
+    class Gauge : public ShardedValue
+    {
+    public:
+        void increment(){ add(1); }
+        void decrement(){ add(-1); }
+    };
+
+    /*
+     *  全局指标注册表
+     *  按名字登记Counter/Gauge，同名返回同一个对象，因此重启的EventLoop、TcpServer会接着累计。
+     *  已经有原子变量维护的数值（如线程池的任务数）不再另外计数，用addGaugeFunc()登记一个读取函数，取快照时才读。
+     *
+     *  登记和取快照用互斥锁保护，只在初始化和取快照时发生；更新指标时不经过注册表，也不加锁。
+     *  所有接口都可跨线程调用。
+     * */
+    class MetricsRegistry : noncopyable
+    {
+    public:
+        using GaugeFunc = std::function<int64_t()>;
+
+        // 快照中的一项
+        struct Sample
+        {
+            std::string name_;
+            int64_t     value_;
+        };
+
+        static MetricsRegistry& instance();
+
+        std::shared_ptr<Counter> counter(const std::string& name);
+        std::shared_ptr<Gauge>   gauge(const std::string& name);
+        int  addGaugeFunc(const std::string& name, GaugeFunc func); // 返回登记号，用于removeGaugeFunc()
+        void removeGaugeFunc(int id);
+
+        std::vector<Sample> snapshot(); // 所有指标的当前值，按名字排序
+        std::string snapshotText();     // 每行一个“名字 值”
+
+    private:
+        explicit MetricsRegistry();
+        ~MetricsRegistry();
+
+    private:
+        pthread_mutex_t mutex_;
+        std::map<std::string, std::shared_ptr<Counter>> counters_;
+        std::map<std::string, std::shared_ptr<Gauge>>   gauges_;
+        std::map<int, std::pair<std::string, GaugeFunc>> gaugeFuncs_; // 登记号 -> (名字, 读取函数)
+        int nextGaugeFuncId_;
+    };
+}
+
+#endif //METRICS_H
@@ -0,0 +1,172 @@
+#ifndef MPSCQUEUE_H
+#define MPSCQUEUE_H
+
+#include "noncopyable.h"
+#include "Types.h"
+
+namespace base
+{
+    /*
+     *  无锁多生产者单消费者队列（Vyukov MPSC）
+     *  链表节点内嵌next_指针，生产者只做一次exchange和一次store，不会互相阻塞；消费者只移动tail_，无需任何原子RMW。
+     *  队列中始终有一个哑节点，tail_指向它，真正的数据在tail_->next_中。
+     *
+     *  节点复用：消费者把取完数据的节点用CAS压入recycled_栈；生产者从自己的线程局部缓存取节点，
+     *  缓存空了就用exchange一次性拿走整个recycled_栈。生产者从不单个弹出节点，因此没有ABA问题。
+     *  稳定运行时push()不会调用malloc（T本身的拷贝除外）。
+     *
+     *  push()可跨线程调用；pop()/consumeAll()/empty()只能在唯一的消费者线程中调用。
+     * */
+    template<typename T>
+    class MpscQueue : noncopyable
+    {
+    public:
+        explicit MpscQueue()
+                : head_(new Node),
+                  recycled_(nullptr),
+                  recycledNum_(0)
+        {
+            head_.load(std::memory_order_relaxed)->next_.store(nullptr, std::memory_order_relaxed);
+            tail_ = head_.load(std::memory_order_relaxed);
+        }
+
+        ~MpscQueue()
+        {
+            T tmp;
+            while(pop(tmp));
+            delete tail_;
+
+            Node* node = recycled_.exchange(nullptr, std::memory_order_acquire);
+            while(node != nullptr)
+            {
+                Node* next = node->next_.load(std::memory_order_relaxed);
+                delete node;
+                node = next;
+            }
+        }
+
+        /// 可跨线程调用
+        void push(T value)
+        {
+            Node* node = allocNode();
+            node->value_ = std::move(value);
+            node->next_.store(nullptr, std::memory_order_relaxed);
+
+            Node* prev = head_.exchange(node, std::memory_order_acq_rel);
+            prev->next_.store(node, std::memory_order_release); // 这一步完成之前消费者看不到node，pop()会暂时返回false
+        }
+
+        /// 不可跨线程调用
+        // 取出一个元素，队列为空（或生产者正处于push()中间）时返回false
+        bool pop(T& value)
+        {
+            Node* tail = tail_;
+            Node* next = tail->next_.load(std::memory_order_acquire);
+            if(next == nullptr)
+                return false;
+
+            value = std::move(next->value_);
+            next->value_ = T(); // next成为新的哑节点，不能再持有数据
+            tail_ = next;
+            recycleNode(tail);
+            return true;
+        }
+
+        // 依次取出并处理调用开始时已在队列中的元素，处理过程中新push的元素留到下一次，返回处理的个数
+        template<typename Func>
+        size_t consumeAll(Func func)
+        {
+            Node* last = head_.load(std::memory_order_acquire);
+            size_t count = 0;
+            T value;
+            while(tail_ != last && pop(value))
+            {
+                func(value);
+                value = T();
+                ++count;
+            }
+            return count;
+        }
+
+        // 包括正处于push()中间的元素在内，队列是否为空
+        bool empty() const
+        {
+            return head_.load(std::memory_order_acquire) == tail_;
+        }
+
+    private:
+        struct Node
+        {
+            std::atomic<Node*> next_;
+            T                  value_;
+        };
+
+        // 生产者线程局部的空闲节点缓存，线程退出时释放
+        struct NodeCache
+        {
+            Node* head_ = nullptr;
+            ~NodeCache()
+            {
+                while(head_ != nullptr)
+                {
+                    Node* next = head_->next_.load(std::memory_order_relaxed);
+                    delete head_;
+                    head_ = next;
+                }
+            }
+        };
+
+        static const int kMaxRecycled = 4096; // recycled_中最多保留的节点数，多余的直接释放
+
+        static NodeCache& localCache()
+        {
+            static thread_local NodeCache cache;
+            return cache;
+        }
+
+        Node* allocNode()
+        {
+            NodeCache& cache = localCache();
+            if(cache.head_ == nullptr)
+            {
+                cache.head_ = recycled_.exchange(nullptr, std::memory_order_acquire);
+                if(cache.head_ != nullptr)
+                    recycledNum_.store(0, std::memory_order_relaxed);
+            }
+            if(cache.head_ == nullptr)
+                return new Node;
+
+            Node* node  = cache.head_;
+            cache.head_ = node->next_.load(std::memory_order_relaxed);
+            return node;
+        }
+
+        void recycleNode(Node* node)
+        {
+            // 计数只是近似值，用于限制缓存的节点数，不要求精确
+            if(recycledNum_.load(std::memory_order_relaxed) >= kMaxRecycled)
+            {
+                delete node;
+                return;
+            }
+            recycledNum_.fetch_add(1, std::memory_order_relaxed);
+
+            Node* top = recycled_.load(std::memory_order_relaxed);
+            do
+            {
+                node->next_.store(top, std::memory_order_relaxed);
+            }
+            while(!recycled_.compare_exchange_weak(top, node, std::memory_order_release, std::memory_order_relaxed));
+        }
+
+    private:
+        std::atomic<Node*> head_;     // 生产者push的位置
+        char pad_[64];                // 隔开生产者和消费者访问的变量，避免伪共享
+        Node*              tail_;     // 消费者pop的位置，只有消费者访问
+
+        std::atomic<Node*> recycled_;    // 消费者回收的节点栈
+        std::atomic<int>   recycledNum_; // recycled_中的节点数（近似）
+    };
+}
+
+#endif //MPSCQUEUE_H
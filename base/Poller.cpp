@@ -0,0 +1,20 @@
+#include "Poller.h"
+#include "EpollPoller.h"
+#include "IoUringPoller.h"
+
+using namespace base;
+
+/*
+ *  创建Poller
+ *  要求io_uring但内核不支持（或被禁用）时，退回epoll
+ */
+Poller* Poller::newPoller(PollerType type)
+{
+    if(type == kIoUring)
+    {
+        std::unique_ptr<IoUringPoller> poller(new IoUringPoller());
+        if(poller->isValid())
+            return poller.release();
+    }
+    return new EpollPoller();
+}
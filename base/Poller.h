@@ -0,0 +1,41 @@
+#ifndef POLLER_H
+#define POLLER_H
+
+#include "noncopyable.h"
+#include "Types.h"
+
+namespace base
+{
+    /*
+     *  IO多路复用的抽象，每个EventLoop持有一个
+     *  就绪事件统一用struct epoll_event表示：events为就绪的事件掩码（EPOLLIN等），data.fd为就绪的fd。
+     *  目前有两种实现：EpollPoller（默认）和IoUringPoller（multishot poll）。
+     *  通过newPoller()创建，内核不支持io_uring时自动退回epoll。
+     *  所有接口都不可跨线程调用。
+     * */
+    class Poller : noncopyable
+    {
+    public:
+        enum PollerType{
+            kEpoll = 0, // epoll
+            kIoUring    // io_uring
+        };
+
+        static Poller* newPoller(PollerType type);
+
+        virtual ~Poller() = default;
+
+        // 等待就绪事件，timeoutMs为-1表示一直等待，为0表示立即返回；就绪事件存放在events的前n项，返回n
+        virtual int  poll(int timeoutMs, std::vector<struct epoll_event>* events) = 0;
+
+        virtual void addFd(int fd, uint32_t events) = 0;
+        virtual void modFd(int fd, uint32_t events) = 0;
+        virtual void delFd(int fd) = 0;
+
+        virtual PollerType getType() = 0;
+        // 是否只能提供边沿触发语义，此时连接必须一直读/写到EAGAIN
+        virtual bool isEdgeTriggeredOnly() = 0;
+    };
+}
+
+#endif //POLLER_H
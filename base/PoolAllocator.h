@@ -0,0 +1,74 @@
+#ifndef POOLALLOCATOR_H
+#define POOLALLOCATOR_H
+
+#include "SlabPool.h"
+
+namespace base
+{
+    /*
+     *  从SlabPool分配内存的标准库分配器
+     *  用于std::allocate_shared（TcpConnection）和std::vector（Buffer）等，持有内存池的shared_ptr，
+     *  保证用它分配的对象释放之前内存池一直有效。没有内存池时（默认构造）退化为operator new/delete。
+     *  容器swap、赋值时分配器随数据一起交换，保证内存总是还给分配它的内存池。
+     * */
+    template<typename T>
+    class PoolAllocator
+    {
+    public:
+        using value_type = T;
+        using propagate_on_container_copy_assignment = std::true_type;
+        using propagate_on_container_move_assignment = std::true_type;
+        using propagate_on_container_swap            = std::true_type;
+
+        template<typename U>
+        struct rebind
+        {
+            using other = PoolAllocator<U>;
+        };
+
+        PoolAllocator() noexcept
+        {
+        }
+        explicit PoolAllocator(std::shared_ptr<SlabPool> pool) noexcept
+                : pool_(std::move(pool))
+        {
+        }
+        template<typename U>
+        PoolAllocator(const PoolAllocator<U>& other) noexcept
+                : pool_(other.getPool())
+        {
+        }
+
+        T* allocate(size_t n)
+        {
+            size_t size = n * sizeof(T);
+            return static_cast<T*>(pool_ ? pool_->allocate(size) : ::operator new(size));
+        }
+        void deallocate(T* ptr, size_t n)
+        {
+            if(pool_)
+                pool_->deallocate(ptr, n * sizeof(T));
+            else
+                ::operator delete(ptr);
+        }
+
+        const std::shared_ptr<SlabPool>& getPool() const { return pool_; }
+
+    private:
+        std::shared_ptr<SlabPool> pool_;
+    };
+
+    template<typename T, typename U>
+    bool operator==(const PoolAllocator<T>& lhs, const PoolAllocator<U>& rhs)
+    {
+        return lhs.getPool() == rhs.getPool();
+    }
+
+    template<typename T, typename U>
+    bool operator!=(const PoolAllocator<T>& lhs, const PoolAllocator<U>& rhs)
+    {
+        return !(lhs == rhs);
+    }
+}
+
+#endif //POOLALLOCATOR_H
@@ -0,0 +1,129 @@
+#include "SlabPool.h"
+
+using namespace base;
+
+/*
+ *  构造函数
+ */
+SlabPool::SlabPool()
+{
+    pthread_mutex_init(&mutex_, nullptr);
+
+    for(int i=0;i < kClassNum;++i)
+    {
+        freeLists_[i] = nullptr;
+        bumpBegin_[i] = nullptr;
+        bumpEnd_[i]   = nullptr;
+    }
+    memset(&stats_, 0, sizeof stats_);
+}
+
+/*
+ *  析构函数
+ *  此时所有从池中分配的内存都已经释放（PoolAllocator持有内存池的引用）
+ */
+SlabPool::~SlabPool()
+{
+    for(char* slab : slabs_)
+        delete[] slab;
+
+    pthread_mutex_destroy(&mutex_);
+}
+
+/*
+ *  申请size字节
+ */
+void* SlabPool::allocate(size_t size)
+{
+    int index = sizeClass(size);
+    if(index < 0)
+    {
+        pthread_mutex_lock(&mutex_);
+        ++stats_.oversize_;
+        pthread_mutex_unlock(&mutex_);
+        return ::operator new(size);
+    }
+
+    const size_t classSize = kMinClassSize << index;
+    void* result = nullptr;
+
+    pthread_mutex_lock(&mutex_);
+    if(freeLists_[index] != nullptr) // 复用之前释放的块
+    {
+        FreeNode* node = freeLists_[index];
+        freeLists_[index] = node->next_;
+        result = node;
+        ++stats_.hits_;
+    }
+    else
+    {
+        if(bumpBegin_[index] == bumpEnd_[index]) // 当前slab用完了，申请新的slab
+        {
+            size_t slabSize = classSize > kSlabSize ? classSize : kSlabSize;
+            char* slab = new char[slabSize];
+            slabs_.push_back(slab);
+            bumpBegin_[index] = slab;
+            bumpEnd_[index]   = slab + slabSize / classSize * classSize;
+            stats_.slabBytes_ += slabSize;
+        }
+        result = bumpBegin_[index];
+        bumpBegin_[index] += classSize;
+        ++stats_.misses_;
+    }
+    ++stats_.inUse_;
+    pthread_mutex_unlock(&mutex_);
+
+    return result;
+}
+
+/*
+ *  释放allocate(size)得到的内存，size必须与申请时相同
+ */
+void SlabPool::deallocate(void* ptr, size_t size)
+{
+    if(ptr == nullptr)
+        return;
+
+    int index = sizeClass(size);
+    if(index < 0)
+    {
+        ::operator delete(ptr);
+        return;
+    }
+
+    FreeNode* node = static_cast<FreeNode*>(ptr);
+    pthread_mutex_lock(&mutex_);
+    node->next_ = freeLists_[index];
+    freeLists_[index] = node;
+    --stats_.inUse_;
+    pthread_mutex_unlock(&mutex_);
+}
+
+/*
+ *  获取统计信息
+ */
+SlabPool::Stats SlabPool::getStats()
+{
+    pthread_mutex_lock(&mutex_);
+    Stats stats = stats_;
+    pthread_mutex_unlock(&mutex_);
+    return stats;
+}
+
+/*
+ *  size所属的级别，超过kMaxClassSize时返回-1
+ */
+int SlabPool::sizeClass(size_t size)
+{
+    if(size > kMaxClassSize)
+        return -1;
+
+    int index = 0;
+    size_t classSize = kMinClassSize;
+    while(classSize < size)
+    {
+        classSize <<= 1;
+        ++index;
+    }
+    return index;
+}
@@ -0,0 +1,67 @@
+#ifndef SLABPOOL_H
+#define SLABPOOL_H
+
+#include "noncopyable.h"
+#include "Types.h"
+
+namespace base
+{
+    /*
+     *  按大小分级的slab内存池，每个EventLoop一个
+     *  申请的大小向上取整到kMinClassSize的2的幂倍（32、64、……、64K），每一级有自己的空闲链表；
+     *  空闲链表为空时从当前slab中切一块，slab用完了再向系统申请一个kSlabSize的slab。
+     *  释放时只把内存挂回所在级别的空闲链表，供之后的连接复用，slab在内存池析构时才还给系统。
+     *  超过kMaxClassSize的申请直接交给operator new。
+     *
+     *  TcpConnection对象的最后一份引用可能在任务线程中释放，因此allocate()/deallocate()都用互斥锁保护，可跨线程调用。
+     *  内存池由PoolAllocator以shared_ptr持有，从池中分配的对象全部释放之后才会析构。
+     * */
+    class SlabPool : noncopyable
+    {
+    public:
+        // 统计信息，hits_/(hits_+misses_)即复用率
+        struct Stats
+        {
+            int64_t hits_;      // 从空闲链表复用的次数
+            int64_t misses_;    // 从slab中切出新内存的次数
+            int64_t oversize_;  // 超过kMaxClassSize、直接operator new的次数
+            int64_t inUse_;     // 当前已分配未释放的块数（不含oversize）
+            int64_t slabBytes_; // 向系统申请的slab总字节数
+        };
+
+        static const size_t kMinClassSize = 32;
+        static const int    kClassNum     = 12;
+        static const size_t kMaxClassSize = kMinClassSize << (kClassNum - 1); // 64K
+        static const size_t kSlabSize     = 64 * 1024;
+
+        /// 可跨线程调用
+        explicit SlabPool();
+        ~SlabPool();
+
+        void* allocate(size_t size);
+        void  deallocate(void* ptr, size_t size);
+
+        Stats getStats();
+
+    private:
+        // 空闲块内嵌的链表节点
+        struct FreeNode
+        {
+            FreeNode* next_;
+        };
+
+        static int sizeClass(size_t size);
+
+    private:
+        pthread_mutex_t mutex_;
+
+        FreeNode* freeLists_[kClassNum]; // 各级空闲链表
+        char*     bumpBegin_[kClassNum]; // 各级当前slab中还没切出去的部分
+        char*     bumpEnd_[kClassNum];
+        std::vector<char*> slabs_;       // 所有slab，析构时释放
+
+        Stats stats_;
+    };
+}
+
+#endif //SLABPOOL_H
@@ -0,0 +1,85 @@
+#include "Strand.h"
+
+using namespace base;
+
+/*
+ *  构造函数
+ */
+Strand::Strand(std::shared_ptr<ThreadPool> taskPool)
+        : taskPool_(std::move(taskPool)),
+          pending_(0)
+{
+}
+
+/*
+ *  投递任务
+ *  没有任务在执行时，把run()提交给线程池
+ */
+void Strand::post(Task task)
+{
+    Item item;
+    item.task_     = std::move(task);
+    item.readTime_ = LatencyRegistry::currentReadTime();
+    item.postNs_   = item.readTime_ != 0 && LatencyRegistry::isEnabled() ? monotonicNanoSeconds() : 0;
+    tasks_.push(std::move(item));
+
+    if(pending_.fetch_add(1, std::memory_order_acq_rel) == 0)
+        submit();
+}
+
+/*
+ *  在线程池中执行，依次执行最多kTasksPerTurn个任务
+ */
+void Strand::run()
+{
+    int done = 0;
+    Item item;
+    while(done < kTasksPerTurn)
+    {
+        if(!tasks_.pop(item))
+        {
+            // pending_还大于0但取不到，说明生产者正处于push()中间，稍等就能取到
+            if(pending_.load(std::memory_order_acquire) > done)
+            {
+                sched_yield();
+                continue;
+            }
+            break;
+        }
+
+        int64_t startNs = 0;
+        if(item.postNs_ != 0)
+        {
+            startNs = monotonicNanoSeconds();
+            LatencyRegistry::record(LatencyRegistry::kPoolQueue, startNs - item.postNs_);
+            LatencyRegistry::currentReadTime() = item.readTime_;
+        }
+
+        item.task_();
+
+        if(startNs != 0)
+        {
+            LatencyRegistry::record(LatencyRegistry::kTaskRun, monotonicNanoSeconds() - startNs);
+            LatencyRegistry::currentReadTime() = 0;
+        }
+        item.task_ = nullptr;
+        ++done;
+    }
+
+    // 还有任务就重新提交，让出工作线程，其他任务也有机会执行
+    if(pending_.fetch_sub(done, std::memory_order_acq_rel) > done)
+        submit();
+}
+
+/*
+ *  把run()提交给线程池，不受任务队列长度限制，否则这个Strand的任务再也不会执行
+ *  提交时清掉当前读取时间，run()本身不计入延迟统计，其中的各任务自己统计
+ */
+void Strand::submit()
+{
+    int64_t& readTime = LatencyRegistry::currentReadTime();
+    int64_t saved = readTime;
+    readTime = 0;
+    taskPool_->addTask(std::bind(&Strand::run, shared_from_this()), true);
+    readTime = saved;
+}
@@ -0,0 +1,53 @@
+#ifndef STRAND_H
+#define STRAND_H
+
+#include "ThreadPool.h"
+#include "MpscQueue.h"
+
+namespace base
+{
+    /*
+     *  串行执行器（strand），每个TcpConnection一个
+     *  投递到同一个Strand的任务在线程池中按投递顺序逐个执行，同一时刻最多只有一个在执行；
+     *  不同Strand的任务仍然在线程池中并行。因此同一个客户端的消息不会被乱序或并发处理，用户不必自己加锁。
+     *
+     *  任务存放在无锁的MpscQueue中，pending_记录还没执行完的任务数：
+     *  post()使pending_从0变为1的那个投递者负责把run()提交给线程池；
+     *  run()每次最多执行kTasksPerTurn个任务，之后如果还有任务就把自己重新提交给线程池，
+     *  这时排在它前面的其他任务可以被空闲的工作线程窃取走，不会因为一个Strand一直有任务而被饿死。
+     *  run()只会有一个在执行，所以MpscQueue只有一个消费者。
+     *
+     *  每个任务各自记下投递时线程局部的“当前读取时间”，执行时恢复，并各自记入LatencyRegistry的pool_queue、task_run阶段；
+     *  提交给线程池的run()本身不属于任何消息，不重复统计。
+     * */
+    class Strand : noncopyable,
+                   public std::enable_shared_from_this<Strand>
+    {
+    public:
+        static const int kTasksPerTurn = 16; // run()每次最多执行的任务数
+
+        /// 可跨线程调用
+        explicit Strand(std::shared_ptr<ThreadPool> taskPool);
+
+        void post(Task task);
+
+    private:
+        // 队列中的任务
+        struct Item
+        {
+            Task    task_;
+            int64_t postNs_;   // 投递时间，统计延迟时才记录
+            int64_t readTime_; // 投递者当时正在处理的消息的读取时间
+        };
+
+        void run();
+        void submit();
+
+    private:
+        std::shared_ptr<ThreadPool> taskPool_; // 执行任务的线程池
+        MpscQueue<Item>   tasks_;   // 待执行的任务
+        std::atomic<int>  pending_; // 已投递但还没执行完的任务数
+    };
+}
+
+#endif //STRAND_H
@@ -0,0 +1,50 @@
+#ifndef STRINGPIECE_H
+#define STRINGPIECE_H
+
+#include "Types.h"
+#include "copyable.h"
+
+namespace base
+{
+    /*
+     *  只读的字符串片段，只保存指针和长度，不持有数据（类似C++17的std::string_view）
+     *  用于把Buffer中的一段数据交给回调而不复制，有效期由提供数据的一方规定
+     * */
+    class StringPiece : public copyable
+    {
+    public:
+        StringPiece()
+                : ptr_(nullptr), length_(0) { }
+        StringPiece(const char* str)
+                : ptr_(str), length_(strlen(str)) { }
+        StringPiece(const std::string& str)
+                : ptr_(str.data()), length_(str.size()) { }
+        StringPiece(const char* offset, size_t len)
+                : ptr_(offset), length_(len) { }
+
+        const char* data() const { return ptr_; }
+        size_t size() const { return length_; }
+        bool empty() const { return length_ == 0; }
+        const char* begin() const { return ptr_; }
+        const char* end() const { return ptr_ + length_; }
+
+        char operator[](size_t i) const { return ptr_[i]; }
+
+        std::string asString() const { return std::string(ptr_, length_); }
+
+        bool operator==(const StringPiece& rhs) const
+        {
+            return length_ == rhs.length_ && memcmp(ptr_, rhs.ptr_, length_) == 0;
+        }
+        bool operator!=(const StringPiece& rhs) const
+        {
+            return !(*this == rhs);
+        }
+
+    private:
+        const char* ptr_;
+        size_t      length_;
+    };
+}
+
+#endif //STRINGPIECE_H
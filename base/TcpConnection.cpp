@@ -3,100 +3,241 @@
 
 using namespace base;
 
+// 当前线程的线程ID，每个线程只做一次系统调用
+static pid_t currentTid()
+{
+    static thread_local pid_t tid = static_cast<pid_t>(::syscall(SYS_gettid));
+    return tid;
+}
+
 /*
  *  构造函数
  */
 TcpConnection::TcpConnection(
-        std::string connectionName,
         int connfd,
         struct sockaddr_in peeraddr,
         std::shared_ptr<ThreadPool> taskPool,
         std::shared_ptr<EventLoop> eventLoop,
         onConnection onConnectionFunc,
         onMessage onMessageFunc,
-        onWriteComplete onWriteCompleteFunc,
-        onCleanTcpSever onCleanTcpSeverFunc)
+        onWriteComplete onWriteCompleteFunc)
         :
-        name_(connectionName),
+        id_(0),
         connected_(true),
+        reading_(true),
+        throttled_(false),
+        backpressure_(false),
+        aboveHighWaterMark_(false),
+        highWaterMark_(0), /*默认不检测输出缓冲水位*/
+        lowWaterMark_(0),
+        outputQueuedNs_(0),
+        outputReadTime_(0),
+        threadId_(0),
+        lastActive_(0),
+        idleTimer_(0),
         socketfd_(connfd),
         peeraddr_(peeraddr),
+        inputBuffer_(0, eventLoop->getSlabPool()), /*只存放没处理完的尾部，用到时再分配*/
+        outputBuffer_(eventLoop->getSlabPool()),
         taskPool_(taskPool),
         eventLoop_(eventLoop),
         onConnection_(onConnectionFunc),
         onMessage_(onMessageFunc),
-        onWriteComplete_(onWriteCompleteFunc),
-        onCleanTcpServer_(onCleanTcpSeverFunc)
+        onWriteComplete_(onWriteCompleteFunc)
 {
 }
 
 /*
  *  析构函数
+ *  加入EventLoop的连接都已经由handleClose()关闭；走到这里还连着的，是还没交给EventLoop就被丢弃的连接，
+ *  onConnection也还没回调过，只关闭socket
  */
 TcpConnection::~TcpConnection()
 {
-    handleClose();
+    if(connected_)
+        close(socketfd_);
+}
+
+/*
+ *  连接加入所属EventLoop后调用，此时已分配ConnectionId
+ *  回调用户设定的onConnection()
+ */
+void TcpConnection::connectEstablished()
+{
+    onConnection_(shared_from_this());
 }
 
 /*
  *  可读事件回调
+ *  LT模式下每次可读事件只读一次，读不完还会再触发；
+ *  ET模式下一直读到EAGAIN，但每次最多读kEdgeTriggeredBudget字节，超出时转为待办下一轮接着读，避免一个连接霸占IO线程
+ *
+ *  inputBuffer_为空时读到EventLoop共用的读缓冲中，onMessage直接在其中解析，回调结束后只把没处理完的尾部复制到inputBuffer_；
+ *  inputBuffer_中还有上次剩下的半条消息时，为了保证数据连续，直接读到inputBuffer_后面。
+ *  inputBuffer_被取空时释放其存储，大多数连接平时不占用输入缓冲。
  */
 void TcpConnection::handleRead()
 {
-    int savedErrno = 0;
-    ssize_t recvBytes = inputBuffer_.readFd(socketfd_,&savedErrno);
+    if(!connected_ || !isReading()) // 同一批事件中或待办里的读，在暂停读之后就不再执行
+        return;
 
-    if(recvBytes > 0) // 收到数据
+    Buffer* readBuffer = inputBuffer_.readableBytes() > 0 ? &inputBuffer_ : eventLoop_->getReadArena();
+    const bool edgeTriggered = eventLoop_->isEdgeTriggered();
+    size_t  totalBytes = 0;
+    bool    peerClosed = false;
+    bool    hasError   = false;
+    bool    drained    = false;
+    int     savedErrno = 0;
+    int64_t readTime   = 0; // 读到数据的时间，用于延迟统计
+
+    while(true)
     {
-        onMessage_(shared_from_this(),&inputBuffer_,peeraddr_);
+        ssize_t recvBytes = readBuffer->readFd(socketfd_,&savedErrno);
+        if(recvBytes > 0) // 收到数据
+        {
+            if(readTime == 0 && LatencyRegistry::isEnabled())
+                readTime = monotonicNanoSeconds();
+            totalBytes += recvBytes;
+            if(!edgeTriggered || totalBytes >= kEdgeTriggeredBudget)
+                break;
+        }
+        else if(recvBytes == 0) // 对等方关闭连接
+        {
+            peerClosed = true;
+            break;
+        }
+        else if(savedErrno == EINTR)
+        {
+            continue;
+        }
+        else if(savedErrno == EAGAIN || savedErrno == EWOULDBLOCK) // 读完了
+        {
+            drained = true;
+            break;
+        }
+        else // 发生错误
+        {
+            hasError = true;
+            break;
+        }
     }
-    else if(recvBytes == 0) // 对等方关闭连接
+
+    if(totalBytes > 0)
     {
-        handleClose();
+        eventLoop_->getMetrics().bytesRead_->add(static_cast<int64_t>(totalBytes));
+        lastActive_ = eventLoop_->getTick();
+
+        // onMessage及其中投递的任务、发送的应答都能取到这次的读取时间
+        LatencyRegistry::currentReadTime() = readTime;
+        onMessage_(shared_from_this(),readBuffer,peeraddr_);
+        if(readTime != 0)
+            LatencyRegistry::record(LatencyRegistry::kOnMessage, monotonicNanoSeconds() - readTime);
+        LatencyRegistry::currentReadTime() = 0;
+
+        if(readBuffer != &inputBuffer_)
+        {
+            // 只把没处理完的尾部留给这个连接，共用的读缓冲交还给EventLoop
+            if(readBuffer->readableBytes() > 0)
+                inputBuffer_.append(readBuffer->peek(),readBuffer->readableBytes());
+            readBuffer->retrieveAll();
+        }
+        else if(inputBuffer_.readableBytes() == 0)
+        {
+            inputBuffer_.release();
+        }
     }
-    else // 发生错误
-    {
+
+    if(peerClosed)
+        handleClose();
+    else if(hasError)
         handleError();
-    }
+    else if(edgeTriggered && !drained && connected_ && isReading()) // 用完了预算还没读完，ET模式下不会再有可读事件，下一轮接着读
+        eventLoop_->addPending(std::bind(&TcpConnection::handleRead,shared_from_this()));
 }
 
 /*
  *  可写事件回调
  *  主要用于一次发送不完时，需要监听可写事件，然后回调handleWrite()把暂存在output buffer中的数据发出去
+ *  ET模式下一直写到EAGAIN或写完，同样受kEdgeTriggeredBudget限制
  */
 void TcpConnection::handleWrite()
 {
-    if(outputBuffer_.readableBytes() > 0)
+    if(!connected_ || outputBuffer_.readableBytes() == 0)
+        return;
+
+    const bool edgeTriggered = eventLoop_->isEdgeTriggered();
+    size_t totalBytes = 0;
+    bool   blocked    = false;
+
+    while(outputBuffer_.readableBytes() > 0)
     {
-        size_t len = write(socketfd_,outputBuffer_.peek(),outputBuffer_.readableBytes());
-        size_t remain = outputBuffer_.readableBytes() - len; // 发送完还剩下多少字节
-        // 没发完
-        if(remain > 0)
+        int savedErrno = 0;
+        ssize_t len = outputBuffer_.writeFd(socketfd_,&savedErrno); // writev，一次交出多个分段
+        if(len > 0)
+        {
+            totalBytes += len;
+            if(!edgeTriggered || totalBytes >= kEdgeTriggeredBudget)
+                break;
+        }
+        else if(len < 0 && savedErrno == EINTR)
         {
-            outputBuffer_.retrieve(len);
+            continue;
         }
-        // 发完了，取消关注可写事件
-        else if(remain == 0)
+        else if(len < 0 && (savedErrno == EAGAIN || savedErrno == EWOULDBLOCK)) // 内核缓冲区满了，等下一次可写事件
         {
-            outputBuffer_.retrieveAll();
-            eventLoop_->disableEpollOut(socketfd_);
-            onWriteComplete_(peeraddr_);
+            blocked = true;
+            break;
         }
-        // 出错了
-        else // remain < 0
+        else // 出错了
         {
             handleError();
+            return;
         }
     }
+
+    if(totalBytes > 0)
+        eventLoop_->getMetrics().bytesWritten_->add(static_cast<int64_t>(totalBytes));
+
+    // 输出缓冲写空，结束对最早那条没写完的应答的跟踪
+    if(outputBuffer_.readableBytes() == 0 && outputQueuedNs_ != 0)
+    {
+        int64_t now = monotonicNanoSeconds();
+        LatencyRegistry::record(LatencyRegistry::kOutputQueue, now - outputQueuedNs_);
+        if(outputReadTime_ != 0)
+            LatencyRegistry::record(LatencyRegistry::kEndToEnd, now - outputReadTime_);
+        outputQueuedNs_ = 0;
+        outputReadTime_ = 0;
+    }
+
+    // 降到低水位，回调一次
+    if(aboveHighWaterMark_ && outputBuffer_.readableBytes() <= lowWaterMark_)
+    {
+        aboveHighWaterMark_ = false;
+        if(onLowWaterMark_)
+            onLowWaterMark_(shared_from_this());
+        if(!connected_) // 回调中可能断开了连接
+            return;
+    }
+
+    // 发完了，取消关注可写事件
+    if(outputBuffer_.readableBytes() == 0)
+    {
+        eventLoop_->disableEpollOut(socketfd_);
+        onWriteComplete_(shared_from_this());
+    }
+    // 用完了预算还没写完，ET模式下不会再有可写事件，下一轮接着写
+    else if(edgeTriggered && !blocked)
+    {
+        eventLoop_->addPending(std::bind(&TcpConnection::handleWrite,shared_from_this()));
+    }
 }
 
 /*
  *  关闭当前连接
  *  可用于主动断开连接
- *  干3件事：
+ *  干2件事：
  *  1.调用用户设定的onConnection()
- *  2.清理TcpServer
- *  3.清理EventLoop，取消监听
+ *  2.清理EventLoop，取消监听
  */
 void TcpConnection::handleClose()
 {
@@ -106,14 +247,8 @@ void TcpConnection::handleClose()
     // 标记已经断开，禁止再向对等方发送数据
     connected_ = false;
 
-    // 用户设定的连接建立、断开的回调
-    onConnection_((void *)&peeraddr_);
-
-    // 清理TcpServer，调用TcpServer::addClean()
-    onCleanTcpServer_(name_);
-
-    // 取消监听可写事件
-    eventLoop_->disableEpollOut(socketfd_);
+    // 用户设定的连接建立、断开的回调，isConnected()已为false
+    onConnection_(shared_from_this());
 
     // 清理EventLoop，取消监听，调用EventLoop::addClean()
     onCleanEventLoop_(socketfd_);
@@ -142,7 +277,40 @@ void TcpConnection::send(std::string message)
         return;
 
     // shared_from_this()是为了防止一旦待办被执行前TcpConnection对象就被销毁，this就成了野指针，将会出现段错误
-    eventLoop_->addPending(std::bind(&TcpConnection::sendInLoop,shared_from_this(),std::move(message)));
+    int64_t readTime = LatencyRegistry::currentReadTime();
+    if(readTime != 0 && LatencyRegistry::isEnabled())
+    {
+        void (TcpConnection::*func)(std::string,int64_t,int64_t) = &TcpConnection::sendFromPending;
+        eventLoop_->addPending(std::bind(func,shared_from_this(),std::move(message),readTime,monotonicNanoSeconds()));
+    }
+    else
+    {
+        void (TcpConnection::*func)(std::string) = &TcpConnection::sendInLoop;
+        eventLoop_->addPending(std::bind(func,shared_from_this(),std::move(message)));
+    }
+    eventLoop_->wakeup();
+}
+
+/*
+ * 发送共享消息给对等方
+ * 任务线程中调用的，需要转调用；只传递引用计数，不复制消息
+ */
+void TcpConnection::send(SharedMessage message)
+{
+    if(!connected_)
+        return;
+
+    int64_t readTime = LatencyRegistry::currentReadTime();
+    if(readTime != 0 && LatencyRegistry::isEnabled())
+    {
+        void (TcpConnection::*func)(const SharedMessage&,int64_t,int64_t) = &TcpConnection::sendFromPending;
+        eventLoop_->addPending(std::bind(func,shared_from_this(),std::move(message),readTime,monotonicNanoSeconds()));
+    }
+    else
+    {
+        void (TcpConnection::*func)(const SharedMessage&) = &TcpConnection::sendInLoop;
+        eventLoop_->addPending(std::bind(func,shared_from_this(),std::move(message)));
+    }
     eventLoop_->wakeup();
 }
 
@@ -152,44 +320,293 @@ void TcpConnection::send(std::string message)
  */
 void TcpConnection::sendInLoop(std::string message)
 {
-    // 如果是待办未执行前连接已经关闭，就不再发送数据给对等方
-    if(!connected_)
+    ssize_t written = writeInLoop(message.data(),message.size());
+    if(written < 0 || static_cast<size_t>(written) == message.size())
         return;
 
-    size_t total = message.size();
+    // 没发完，剩余部分比较大时把message本身挪进SharedMessage挂到output buffer上，省去一次复制
+    bool wasEmpty = outputBuffer_.readableBytes() == 0;
+    size_t remain = message.size() - written;
+    if(remain >= ChainBuffer::kShareThreshold)
+        outputBuffer_.append(std::make_shared<const std::string>(std::move(message)),written);
+    else
+        outputBuffer_.append(message.data()+written,remain);
 
-    // 如果output中有数据，就不发送，把message附加在后面
-    if(outputBuffer_.readableBytes() > 0)
+    if(wasEmpty)
     {
-        outputBuffer_.append(message.c_str(),total);
+        eventLoop_->enableEpollOut(socketfd_); // 关注可写事件
+        markOutputQueued();
+    }
+
+    checkHighWaterMark();
+}
+
+/*
+ * 发送共享消息给对等方
+ * IO线程中调用，没发完的部分只引用message，不复制
+ */
+void TcpConnection::sendInLoop(const SharedMessage& message)
+{
+    if(!message)
+        return;
+
+    ssize_t written = writeInLoop(message->data(),message->size());
+    if(written < 0 || static_cast<size_t>(written) == message->size())
         return;
+
+    bool wasEmpty = outputBuffer_.readableBytes() == 0;
+    outputBuffer_.append(message,written);
+
+    if(wasEmpty)
+    {
+        eventLoop_->enableEpollOut(socketfd_); // 关注可写事件
+        markOutputQueued();
     }
 
-    // 前面没有未发完的数据，可以直接发送
-    size_t len = write(socketfd_,message.c_str(),total);
-    if(len >= 0)
+    checkHighWaterMark();
+}
+
+/*
+ * 发送[data, data+len)给对等方
+ * IO线程中调用，没发完的部分复制到output buffer
+ */
+void TcpConnection::sendInLoop(const char* data, size_t len)
+{
+    ssize_t written = writeInLoop(data,len);
+    if(written < 0 || static_cast<size_t>(written) == len)
+        return;
+
+    bool wasEmpty = outputBuffer_.readableBytes() == 0;
+    outputBuffer_.append(data+written,len-written);
+
+    if(wasEmpty)
     {
-        size_t remain = total - len; // 剩余没发送的字节数
+        eventLoop_->enableEpollOut(socketfd_); // 关注可写事件
+        markOutputQueued();
+    }
 
-        // 这次发送完了，回调onWriteComplete_
-        if(remain == 0)
-        {
-            onWriteComplete_(peeraddr_);
-        }
-        // 这次没发完
-        else if(remain > 0)
+    checkHighWaterMark();
+}
+
+/*
+ * send()转过来的待办，统计延迟时使用
+ * 记下send()到这里的等待时间，恢复消息的读取时间后再发送
+ */
+void TcpConnection::sendFromPending(std::string message, int64_t readTime, int64_t sendNs)
+{
+    LatencyRegistry::record(LatencyRegistry::kSendPending, monotonicNanoSeconds() - sendNs);
+    LatencyRegistry::currentReadTime() = readTime;
+    sendInLoop(std::move(message));
+    LatencyRegistry::currentReadTime() = 0;
+}
+
+void TcpConnection::sendFromPending(const SharedMessage& message, int64_t readTime, int64_t sendNs)
+{
+    LatencyRegistry::record(LatencyRegistry::kSendPending, monotonicNanoSeconds() - sendNs);
+    LatencyRegistry::currentReadTime() = readTime;
+    sendInLoop(message);
+    LatencyRegistry::currentReadTime() = 0;
+}
+
+/*
+ * 输出缓冲由空变为非空，开始跟踪这条应答，直到输出缓冲写空
+ */
+void TcpConnection::markOutputQueued()
+{
+    if(!LatencyRegistry::isEnabled())
+        return;
+
+    outputQueuedNs_ = monotonicNanoSeconds();
+    outputReadTime_ = LatencyRegistry::currentReadTime();
+}
+
+/*
+ * output buffer为空时直接write，返回写出的字节数，全部写完时回调onWriteComplete_
+ * output buffer中还有数据时不能插队，返回0；连接已经关闭或出错时返回-1
+ */
+ssize_t TcpConnection::writeInLoop(const char* data, size_t len)
+{
+    // 如果是待办未执行前连接已经关闭，就不再发送数据给对等方
+    if(!connected_)
+        return -1;
+
+    // 如果output中有数据，就不发送，由调用者附加在后面
+    if(outputBuffer_.readableBytes() > 0)
+        return 0;
+
+    // 前面没有未发完的数据，可以直接发送
+    ssize_t written = ::write(socketfd_,data,len);
+    if(written < 0)
+    {
+        // 内核缓冲区满了，全部暂存到output buffer
+        if(errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
         {
-            outputBuffer_.append(message.c_str()+len,remain);
-            eventLoop_->enableEpollOut(socketfd_); // 关注可写事件
+            written = 0;
         }
-        // 出错了
-        else // remain < 0
+        else // 出错了
         {
             handleError();
+            return -1;
         }
     }
-    else // len < 0
+
+    if(written > 0)
+        eventLoop_->getMetrics().bytesWritten_->add(written);
+
+    // 这次发送完了，回调onWriteComplete_
+    if(static_cast<size_t>(written) == len)
     {
-        handleError();
+        int64_t readTime = LatencyRegistry::currentReadTime();
+        if(readTime != 0 && LatencyRegistry::isEnabled())
+            LatencyRegistry::record(LatencyRegistry::kEndToEnd, monotonicNanoSeconds() - readTime);
+        onWriteComplete_(shared_from_this());
+    }
+
+    return written;
+}
+
+/*
+ * 把任务交给线程池
+ * 线程池饱和时，背压模式下任务照样投递（不丢失），同时暂停读本连接，等线程池任务数降到低水位时由EventLoop恢复；
+ * 非背压模式下丢弃任务，返回false
+ */
+bool TcpConnection::addTaskToPool(Task func)
+{
+    if(taskPool_->addTask(func))
+        return true;
+    if(!backpressure_)
+        return false;
+
+    throttle();
+    return taskPool_->addTask(std::move(func), true);
+}
+
+/*
+ * 把任务交给线程池，同一个连接的任务按投递顺序逐个执行，不同连接的任务并行
+ * IO线程中调用（通常在onMessage中）
+ * Strand的任务总是会被执行；背压模式下线程池饱和时同样暂停读本连接
+ */
+void TcpConnection::addOrderedTaskToPool(Task func)
+{
+    if(!strand_)
+        strand_ = std::make_shared<Strand>(taskPool_);
+
+    // Strand总是以ignoreLimit投递，线程池不会拒绝任务，也就不会自己记为饱和，由throttleInLoop()记
+    if(backpressure_ && taskPool_->isFull())
+        throttle();
+
+    strand_->post(std::move(func));
+}
+
+/*
+ * 输出缓冲越过高水位时回调一次，降到低水位之前不再回调
+ * 放在sendInLoop()最后，回调中断开连接也不影响后续操作
+ */
+void TcpConnection::checkHighWaterMark()
+{
+    if(highWaterMark_ == 0 || aboveHighWaterMark_ || outputBuffer_.readableBytes() < highWaterMark_)
+        return;
+
+    aboveHighWaterMark_ = true;
+    if(onHighWaterMark_)
+        onHighWaterMark_(shared_from_this(), outputBuffer_.readableBytes());
+}
+
+/*
+ * 暂停读
+ * IO线程中调用
+ */
+void TcpConnection::stopReadingInLoop()
+{
+    reading_ = false;
+    updateReading();
+}
+
+/*
+ * 恢复读
+ * IO线程中调用
+ */
+void TcpConnection::startReadingInLoop()
+{
+    reading_ = true;
+    updateReading();
+}
+
+/*
+ * 因线程池饱和暂停读，登记到EventLoop等待恢复
+ * IO线程中调用
+ * 从其他线程转来的待办执行时，线程池可能已经降到低水位、恢复过一轮了，所以再检查一次是否仍然饱和；
+ * 登记后把线程池记为饱和，保证之后降到低水位时会回调恢复（已经降下来了就立即回调）
+ */
+void TcpConnection::throttleInLoop()
+{
+    if(throttled_ || !connected_ || !taskPool_->isFull())
+        return;
+
+    throttled_ = true;
+    eventLoop_->addThrottled(id_);
+    updateReading();
+
+    taskPool_->markSaturated();
+}
+
+/*
+ * 线程池降到低水位后恢复读
+ * IO线程中调用，由EventLoop::resumeThrottledInLoop()调用
+ */
+void TcpConnection::unthrottleInLoop()
+{
+    throttled_ = false;
+    updateReading();
+}
+
+/*
+ * 暂停读
+ * 可跨线程调用，转为待办
+ */
+void TcpConnection::stopReading()
+{
+    eventLoop_->addPending(std::bind(&TcpConnection::stopReadingInLoop,shared_from_this()));
+    eventLoop_->wakeup();
+}
+
+/*
+ * 恢复读
+ * 可跨线程调用，转为待办
+ */
+void TcpConnection::startReading()
+{
+    eventLoop_->addPending(std::bind(&TcpConnection::startReadingInLoop,shared_from_this()));
+    eventLoop_->wakeup();
+}
+
+/*
+ * 按reading_和throttled_更新是否关注可读事件
+ * 恢复读时，ET模式下还有没读完的数据由重新MOD产生的可读事件触发
+ */
+void TcpConnection::updateReading()
+{
+    if(!connected_)
+        return;
+
+    if(isReading())
+        eventLoop_->enableReading(socketfd_);
+    else
+        eventLoop_->disableReading(socketfd_);
+}
+
+/*
+ * 因线程池饱和暂停读
+ * 通常在IO线程的onMessage中调用，直接生效；在其他线程中调用时转为待办
+ */
+void TcpConnection::throttle()
+{
+    if(currentTid() == threadId_)
+    {
+        throttleInLoop();
+        return;
     }
-}
\ No newline at end of file
+
+    eventLoop_->addPending(std::bind(&TcpConnection::throttleInLoop,shared_from_this()));
+    eventLoop_->wakeup();
+}
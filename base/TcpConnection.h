@@ -3,7 +3,9 @@
 
 #include "noncopyable.h"
 #include "Buffer.h"
-#include "ThreadPool.h"
+#include "ChainBuffer.h"
+#include "Strand.h"
+#include "LatencyHistogram.h"
 
 namespace base
 {
@@ -11,36 +13,54 @@ namespace base
 
     /*
      *  保存一个Tcp连接
-     *  生命周期由shared_ptr控制，正常运作时保留2份指向其对象的引用计数：TcpServer和EventLoop的connections_各有一份。
+     *  生命周期由shared_ptr控制，正常运作时只保留1份指向其对象的引用计数：所属EventLoop的connections_中。
+     *  TcpServer不持有连接，只通过ConnectionId（所属IO线程下标 + generation + fd）找到连接所在的EventLoop。
      *
-     *  断开连接时，首先在loop()中curConnection_临时保存一份引用（引用剩余3），
-     *  然后调用TcpConnection::handleRead()，再跳到TcpConnection::handleClose()；
-     *  在handleClose()中，先调用TcpServer::addClean()告知server从其connections_中清理掉一份引用（引用剩余2）；
-     *  然后调用EventLoop::addClean()，告知eventloop从其connections_中清理掉一份引用，并取消监听（引用剩余1）；
-     *  最后回到loop()中，curConnection_改变指向，保存的引用消失（引用剩余0）。
-     *  由于“server清理”和“curConnection_改变指向”位于不同线程，因此是两者中后发生者析构了TcpConnection对象。
+     *  断开连接时，loop()中调用TcpConnection::handleRead()，再跳到TcpConnection::handleClose()；
+     *  在handleClose()中调用EventLoop::addClean()，eventloop取消监听，并把connections_中的引用挪到closings_中暂存；
+     *  最后回到loop()中，本轮循环末尾清空closings_，保存的引用消失，析构TcpConnection对象。
+     *  fd被新连接复用时generation不同，旧的ConnectionId查不到新连接。
      *
      *  还有可能任务列表中还有task函数bind了TcpConnection的shared_ptr，这会导致无法马上销毁TcpConnection对象
+     *
+     *  是否读取对等方的数据由两个条件共同决定：用户的stopReading()/startReading()，以及线程池饱和时的背压暂停（throttle）。
+     *  两者都不阻止读时才关注可读事件；暂停期间数据留在内核接收缓冲区中，由TCP流量控制让对等方慢下来。
+     *
+     *  输出缓冲水位：sendInLoop()后输出缓冲字节数从下往上越过highWaterMark_时回调一次onHighWaterMark_，
+     *  handleWrite()把它发到lowWaterMark_及以下时回调一次onLowWaterMark_。两个回调都在IO线程中执行，
+     *  可以在其中stopReadingInLoop()/startReadingInLoop()节流（如聊天室中消费慢的成员），或handleClose()直接断开。
+     *
+     *  LatencyRegistry开启时，handleRead()在读到数据时打时间戳，作为线程局部的“当前读取时间”传给onMessage及其投递的任务；
+     *  应答一次写完时记端到端延迟；没写完时只跟踪输出缓冲由空变为非空时的那条应答，输出缓冲写空时记output_queue和端到端延迟。
      * */
     class TcpConnection : noncopyable,
                             public std::enable_shared_from_this<TcpConnection>
     {
     public:
+        static const size_t kEdgeTriggeredBudget = 256 * 1024; // ET模式下每次读/写事件最多处理的字节数
+
         /// 不可跨线程调用
-        explicit TcpConnection(std::string connectionName,
-                               int connfd,
+        explicit TcpConnection(int connfd,
                                struct sockaddr_in peeraddr,
                                std::shared_ptr<ThreadPool> taskPool,
                                std::shared_ptr<EventLoop> eventLoop,
                                onConnection    onConnectionFunc,
                                onMessage       onMessageFunc,
-                               onWriteComplete onWriteCompleteFunc,
-                               onCleanTcpSever onCleanTcpSeverFunc);
+                               onWriteComplete onWriteCompleteFunc);
         ~TcpConnection();
 
-        std::string getName(){ return name_; }
+        ConnectionId getId(){ return id_; } // 加入EventLoop前为0
+        void setId(ConnectionId id){ id_ = id; }
         int getFd(){ return socketfd_; }
+        const struct sockaddr_in& getPeerAddr(){ return peeraddr_; }
+        bool isConnected(){ return connected_; }
 
+        int64_t getLastActive(){ return lastActive_; }
+        void setLastActive(int64_t tick){ lastActive_ = tick; }
+        TimerId getIdleTimer(){ return idleTimer_; }
+        void setIdleTimer(TimerId timerId){ idleTimer_ = timerId; }
+
+        void connectEstablished();
         void handleRead();
         void handleWrite();
         void handleClose();
@@ -49,30 +69,68 @@ namespace base
         void setTid(pid_t tid){ threadId_ = tid; }
         void setonCleanEventLoop(onCleanEventLoop func){ onCleanEventLoop_ = func; }
 
-        void addTaskToPool(Task func){ taskPool_->addTask(func); }
+        bool addTaskToPool(Task func); // 线程池饱和时：背压模式下照样投递并暂停读本连接，否则丢弃任务返回false
+        void addOrderedTaskToPool(Task func); // 同一个连接的任务按顺序逐个执行
+
+        void setBackpressure(bool on){ backpressure_ = on; }
+        void setHighWaterMark(size_t bytes, onHighWaterMark func){ highWaterMark_ = bytes; onHighWaterMark_ = std::move(func); } // 0表示不检测
+        void setLowWaterMark(size_t bytes, onLowWaterMark func){ lowWaterMark_ = bytes; onLowWaterMark_ = std::move(func); }
+        size_t getOutputBytes(){ return outputBuffer_.readableBytes(); } // 输出缓冲中还没发出的字节数
+        bool isReading(){ return reading_ && !throttled_; }
+        void stopReadingInLoop();
+        void startReadingInLoop();
+        void throttleInLoop();
+        void unthrottleInLoop();
 
         void sendInLoop(std::string message);
+        void sendInLoop(const SharedMessage& message);
+        void sendInLoop(const char* data, size_t len);
 
         /// 可跨线程调用
         void send(std::string message);
+        void send(SharedMessage message); // 同一条消息发给多个连接时不复制数据
+        void stopReading();  // 暂停读，已经读到的数据照常处理
+        void startReading(); // 恢复读
+
+    private:
+        ssize_t writeInLoop(const char* data, size_t len);
+        void sendFromPending(std::string message, int64_t readTime, int64_t sendNs);
+        void sendFromPending(const SharedMessage& message, int64_t readTime, int64_t sendNs);
+        void markOutputQueued();
+        void updateReading();
+        void checkHighWaterMark();
+        void throttle();
 
     private:
         bool connected_;
+        bool reading_;       // 用户是否允许读，stopReading()/startReading()
+        bool throttled_;     // 是否因线程池饱和被暂停读
+        bool backpressure_;  // 线程池饱和时是否暂停读，而不是丢弃任务
+        bool aboveHighWaterMark_; // 输出缓冲越过高水位后还没降到低水位
+        size_t highWaterMark_;    // 输出缓冲高水位，0表示不检测
+        size_t lowWaterMark_;     // 输出缓冲低水位
+        int64_t outputQueuedNs_;  // 输出缓冲由空变为非空的时间，0表示没有在统计
+        int64_t outputReadTime_;  // 此时正在应答的消息的读取时间
 
         pid_t threadId_; // 所属IO线程的线程ID
+        int64_t lastActive_; // 最近一次收到数据时EventLoop时间轮的tick，用于空闲连接检测
+        TimerId idleTimer_;  // 空闲连接检测的定时器，连接关闭时取消，0表示没有
 
-        std::string        name_;     // 每个TcpConnection对象的唯一标识符，格式为：Tcp[xxxxxx……]（[]中为64位的时间字符串，以us为单位）
+        ConnectionId       id_;       // 每个TcpConnection对象的唯一标识符，由所属EventLoop分配
         int                socketfd_; // 连接对应的socket文件描述符
         struct sockaddr_in peeraddr_;
 
-        Buffer inputBuffer_,outputBuffer_;      // 应用层缓冲区，内部数据以网络字节序存放
+        Buffer      inputBuffer_;  // 应用层输入缓冲区，只存放onMessage没处理完的数据，内部数据以网络字节序存放
+        ChainBuffer outputBuffer_; // 应用层输出缓冲区，分段存放，大消息只引用不复制
         std::shared_ptr<ThreadPool> taskPool_;  // TcpServer拥有的任务处理线程池
+        std::shared_ptr<Strand>     strand_;    // 本连接的串行执行器，第一次使用时创建
         std::shared_ptr<EventLoop>  eventLoop_; // 所属的EventLoop对象
 
         onConnection       onConnection_;     // 连接建立、断开回调
         onMessage          onMessage_;        // 收到消息回调，去往TcpServer更上层的回调
         onWriteComplete    onWriteComplete_;  // 发送完毕回调
-        onCleanTcpSever    onCleanTcpServer_; // Tcp连接关闭时，清理TcpServer::connections_的回调
+        onHighWaterMark    onHighWaterMark_;  // 输出缓冲越过高水位回调
+        onLowWaterMark     onLowWaterMark_;   // 输出缓冲降到低水位回调
         onCleanEventLoop   onCleanEventLoop_; // Tcp连接关闭时，清理EventLoop::connections_的回调，并取消监听
     };
 }
@@ -11,10 +11,11 @@ TcpServer::TcpServer(
         std::string port,
         onConnection    onConnectionFunc,
         onMessage       onMessageFunc,
-        onWriteComplete onWriteCompleteFunc)
+        onWriteComplete onWriteCompleteFunc,
+        Poller::PollerType pollerType)
         :
         taskPool_(new ThreadPool(taskPoolSize)),    /*任务处理线程池*/
-        ioThreadsNum_(ioPoolSize),            /*IO线程数量*/
+        ioThreadsNum_(ioPoolSize),            /*IO线程数量，不超过kMaxConnectionLoops*/
         ip_(INADDR_ANY),                      /*监听地址*/
         port_(port),                          /*监听端口*/
         onConnection_(onConnectionFunc),      /*回调*/
@@ -23,29 +24,30 @@ TcpServer::TcpServer(
         running_(false),
         idlefd_(::open("/dev/null", O_RDONLY | O_CLOEXEC)), /*空闲fd*/
         epollfd_(epoll_create1(EPOLL_CLOEXEC)), /*epoll实例*/
+        idleTimeout_(0),   /*默认不检测空闲连接*/
+        edgeTriggered_(false), /*默认LT模式*/
+        reusePort_(false), /*默认由主线程accept*/
+        backpressure_(false), /*默认线程池饱和时丢弃任务*/
+        highWaterMark_(0), /*默认不检测输出缓冲水位*/
+        lowWaterMark_(0),
+        stallThresholdMs_(0), /*默认不检测IO线程卡顿*/
+        maxAcceptsPerWakeup_(kDefaultMaxAcceptsPerWakeup), /*每次可读事件最多accept的连接数*/
+        pollerType_(pollerType), /*IO线程的Poller*/
+        loopSelectPolicy_(kRoundRobin), /*默认轮叫*/
+        lastBusySampleUs_(0),
         nextEventLoop_(0)  /*IO线程轮叫的下一个*/
 {
     signal(SIGPIPE, SIG_IGN); // 忽略信号SIGPIPE。当客户端断开tcp连接后，服务器再向其发送两次信息则服务器进程会收到SIGPIPE信号。这个信号的默认处理是结束进程。
     signal(SIGCHLD, SIG_IGN); // 避免僵尸进程
 
-    // 【1】采用IPV4的TCP，流式，非阻塞，不可继承
-    listenfd_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
-    // 【2】设置IP PORT复用
-    int optval = 1;
-    setsockopt(listenfd_, SOL_SOCKET, SO_REUSEADDR,
-               &optval, static_cast<socklen_t>(sizeof(optval)));
-    setsockopt(listenfd_, SOL_SOCKET, SO_REUSEPORT,
-                           &optval, static_cast<socklen_t>(sizeof(optval)));
-    // 【3】绑定IP PORT
-    struct sockaddr_in tmpData;
-    tmpData.sin_family      = AF_INET;
-    tmpData.sin_port        = htons(atoi(port.c_str()));
-    tmpData.sin_addr.s_addr = ip_;
-    bind(listenfd_,(struct sockaddr *)&tmpData,sizeof(tmpData));
+    assert(ioThreadsNum_ > 0 && ioThreadsNum_ <= kMaxConnectionLoops); // ConnectionId中IO线程下标只有8位
+
+    // 【1】~【3】创建listen socket，设置IP PORT复用，绑定IP PORT
+    listenfd_ = createListenSocket(ip_, port_);
 
     // 初始化互斥锁
     pthread_mutex_init(&eventLoopsMutex_, nullptr);
-    pthread_mutex_init(&cleanMutex_, nullptr);
+    pthread_cond_init(&eventLoopsCond_, nullptr);
 }
 
 /*
@@ -62,7 +64,7 @@ TcpServer::~TcpServer()
 
     // 销毁互斥锁
     pthread_mutex_destroy(&eventLoopsMutex_);
-    pthread_mutex_destroy(&cleanMutex_);
+    pthread_cond_destroy(&eventLoopsCond_);
 }
 
 /*
@@ -74,19 +76,32 @@ void TcpServer::start()
     if(running_)
         return;
 
-    // 启动任务处理线程池
+    // 启动任务处理线程池，背压模式下任务数降到低水位时恢复被暂停读的连接
+    if(backpressure_)
+        taskPool_->setDrainCallback(std::bind(&TcpServer::resumeThrottledConnections,this));
     taskPool_->startPool();
 
     // 创建IO线程池
     createEventLoopThreadPool();
 
-    // 【4】设置监听
-    listen(listenfd_,SOMAXCONN);
-    // 【5】将listenfd_加入监听队列
-    struct epoll_event event;
-    event.events  = EPOLLIN;
-    event.data.fd = listenfd_;
-    epoll_ctl(epollfd_, EPOLL_CTL_ADD, listenfd_, &event);
+    // 开始检测IO线程卡顿
+    if(stallThresholdMs_ > 0)
+    {
+        watchdog_.reset(new LoopWatchdog(stallThresholdMs_, onLoopStall_));
+        watchdog_->start(eventLoops_);
+    }
+
+    // 各IO线程自己accept时，主线程的listenfd_不参与监听，下面的循环只是阻塞主线程
+    if(!reusePort_)
+    {
+        // 【4】设置监听
+        listen(listenfd_,SOMAXCONN);
+        // 【5】将listenfd_加入监听队列
+        struct epoll_event event;
+        event.events  = EPOLLIN;
+        event.data.fd = listenfd_;
+        epoll_ctl(epollfd_, EPOLL_CTL_ADD, listenfd_, &event);
+    }
 
     // 进入监听循环
     acceptNewConnection();
@@ -110,11 +125,14 @@ void TcpServer::stop()
     // 停止任务处理线程池
     taskPool_->stopPool();
 
-    // 关闭所有TcpConnection
-    for(auto conn:connections_)
-        conn.second->handleClose();
+    // 先停止卡顿检测，释放其持有的EventLoop引用
+    if(watchdog_)
+    {
+        watchdog_->stop();
+        watchdog_.reset();
+    }
 
-    // 关闭IO线程池
+    // 关闭IO线程池，各EventLoop退出loop()后关闭自己的TcpConnection
     stopEventLoopThreadPool();
 
     // 清空IO线程对象
@@ -125,71 +143,306 @@ void TcpServer::stop()
 }
 
 /*
- *  创建一个新的TcpConnection对象，保存至connections_
- *  将新的TcpConnection对象用round Robin方式分配给各个IO EventLoop
+ *  创建一个新的TcpConnection对象，按loopSelectPolicy_分配给一个IO EventLoop
  */
 void TcpServer::createNewTcpConnection(int connfd,struct sockaddr_in peeraddr)
 {
-    // 每个TcpConnection的name字符串为：Tcp[xxxxxx……]（64位的时间字符串）
-    std::string connectionName;
-
-    // 获取当前时间，从1970年至今的us数
-    struct timeval time;
-    gettimeofday(&time, NULL);
-    int64_t seconds = time.tv_sec;
-    int64_t microSeconds = seconds * kMicroSecondsPerSecond + time.tv_usec;
-    connectionName = "Tcp[" + std::to_string(microSeconds) + "]";
-
-    // 用shared_ptr保存新建的TcpConnection对象，并将之存入connections_
-    assert(nextEventLoop_<ioThreadsNum_);
-    std::shared_ptr<TcpConnection> newConnection(new TcpConnection(connectionName,
-                                                                   connfd,
-                                                                   peeraddr,
-                                                                   taskPool_,
-                                                                   eventLoops_[nextEventLoop_],
-                                                                   onConnection_,
-                                                                   onMessage_,
-                                                                   onWriteComplete_,
-                                                                   std::bind(&TcpServer::addClean,this,std::placeholders::_1)));
+    int loopIndex = selectEventLoop(peeraddr);
+    assert(loopIndex<ioThreadsNum_);
+    std::shared_ptr<TcpConnection> newConnection = newTcpConnection(connfd,
+                                                                    peeraddr,
+                                                                    eventLoops_[loopIndex]);
+
+    // 先暂存，由dispatchNewConnections()成批交付
+    newConnections_[loopIndex].push_back(std::move(newConnection));
+}
+
+/*
+ *  按loopSelectPolicy_为新连接选择IO线程，返回下标
+ *  IO线程的连接数、忙碌时间都是跨线程读取的近似值，本轮还没交付的连接也要算上
+ */
+int TcpServer::selectEventLoop(const struct sockaddr_in& peeraddr)
+{
+    switch(loopSelectPolicy_)
+    {
+        case kLeastConnections:
+        {
+            int best = 0;
+            int bestNum = 0;
+            for(int i=0;i < ioThreadsNum_;++i)
+            {
+                int num = eventLoops_[i]->getConnectionNum() + static_cast<int>(newConnections_[i].size());
+                if(i == 0 || num < bestNum)
+                {
+                    best    = i;
+                    bestNum = num;
+                }
+            }
+            return best;
+        }
+        case kLeastBusy:
+            return selectLeastBusy();
+        case kConsistentHash:
+        {
+            // 默认key带上端口，否则同一NAT后、回环地址上的客户端全都落在同一个IO线程
+            uint64_t key = hashKeyFunc_ ? hashKeyFunc_(peeraddr) :
+                           (static_cast<uint64_t>(peeraddr.sin_addr.s_addr) << 16) | peeraddr.sin_port;
+            return getLoopIndexForKey(key);
+        }
+        case kRoundRobin:
+        default:
+        {
+            int loopIndex = nextEventLoop_;
+            nextEventLoop_ = (++nextEventLoop_) >= ioThreadsNum_ ? 0 : nextEventLoop_;
+            return loopIndex;
+        }
+    }
+}
+
+/*
+ *  一致性哈希：返回key落在哪个IO线程
+ *  同一个key总是得到同一个下标，可以用来把同一聊天室、同一用户的工作路由到同一个IO线程
+ */
+int TcpServer::getLoopIndexForKey(uint64_t key)
+{
+    if(hashRing_.empty())
+        return 0;
+
+    std::pair<uint64_t,int> target(hashMix(key), -1);
+    std::vector<std::pair<uint64_t,int>>::const_iterator it = std::lower_bound(hashRing_.begin(), hashRing_.end(), target);
+    if(it == hashRing_.end())
+        it = hashRing_.begin(); // 环绕回第一个虚拟节点
+    return it->second;
+}
+
+/*
+ *  选择最近忙碌时间最少的IO线程
+ *  每kBusySampleIntervalUs采样一次各IO线程的累计忙碌时间；两次采样之间，每分配一个连接就给该IO线程加上
+ *  平均每连接的忙碌时间作为估计，避免一批新连接全部涌向同一个IO线程
+ */
+int TcpServer::selectLeastBusy()
+{
+    int64_t now = monotonicMicroSeconds();
+    if(now - lastBusySampleUs_ >= kBusySampleIntervalUs)
+    {
+        for(int i=0;i < ioThreadsNum_;++i)
+        {
+            int64_t busy = eventLoops_[i]->getBusyTimeUs();
+            recentBusyTimeUs_[i] = busy - lastBusyTimeUs_[i];
+            lastBusyTimeUs_[i]   = busy;
+        }
+        lastBusySampleUs_ = now;
+    }
+
+    int64_t totalBusy = 0;
+    int     totalConnections = 0;
+    int     best = 0;
+    for(int i=0;i < ioThreadsNum_;++i)
+    {
+        totalBusy        += recentBusyTimeUs_[i];
+        totalConnections += eventLoops_[i]->getConnectionNum();
+        if(recentBusyTimeUs_[i] < recentBusyTimeUs_[best])
+            best = i;
+    }
+
+    int64_t perConnection = totalConnections > 0 ? totalBusy / totalConnections : 0;
+    recentBusyTimeUs_[best] += std::max(perConnection, static_cast<int64_t>(1));
+    return best;
+}
+
+/*
+ *  构建一致性哈希环，每个IO线程kVirtualNodesPerLoop个虚拟节点
+ */
+void TcpServer::buildHashRing()
+{
+    hashRing_.clear();
+    for(int i=0;i < ioThreadsNum_;++i)
+    {
+        for(int v=0;v < kVirtualNodesPerLoop;++v)
+        {
+            uint64_t node = (static_cast<uint64_t>(i) << 32) | static_cast<uint64_t>(v);
+            hashRing_.push_back(std::make_pair(hashMix(node), i));
+        }
+    }
+    std::sort(hashRing_.begin(), hashRing_.end());
+}
+
+/*
+ *  64位整数的哈希（splitmix64的最后一步），让相近的key也能均匀分布在环上
+ */
+uint64_t TcpServer::hashMix(uint64_t key)
+{
+    key ^= key >> 30;
+    key *= 0xbf58476d1ce4e5b9ULL;
+    key ^= key >> 27;
+    key *= 0x94d049bb133111ebULL;
+    key ^= key >> 31;
+    return key;
+}
+
+/*
+ *  把newConnections_中暂存的新连接成批交给各IO线程
+ */
+void TcpServer::dispatchNewConnections()
+{
+    for(int i=0;i < ioThreadsNum_;++i)
+    {
+        if(newConnections_[i].empty())
+            continue;
+
+        eventLoops_[i]->addConnections(std::move(newConnections_[i]));
+        newConnections_[i].clear();
+    }
+}
+
+/*
+ *  IO线程自己accept到新连接时的回调，在IO线程中执行
+ *  新的TcpConnection对象只保存在所属EventLoop中，不经过主线程
+ */
+void TcpServer::acceptInLoop(std::weak_ptr<EventLoop> weakEventLoop,int connfd,struct sockaddr_in peeraddr)
+{
+    std::shared_ptr<EventLoop> eventLoop = weakEventLoop.lock();
+    if(!eventLoop)
+    {
+        close(connfd);
+        return;
+    }
+
+    // 加入EventLoop时分配ConnectionId，并回调onConnection
+    eventLoop->addConnectionInLoop(newTcpConnection(connfd,peeraddr,eventLoop));
+}
+
+/*
+ *  创建一个新的TcpConnection对象
+ */
+std::shared_ptr<TcpConnection> TcpServer::newTcpConnection(int connfd,
+                                                           struct sockaddr_in peeraddr,
+                                                           std::shared_ptr<EventLoop> eventLoop)
+{
+    // ConnectionId在加入EventLoop时由EventLoop分配
+    // TcpConnection对象和引用计数控制块一起从所属EventLoop的内存池分配，连接关闭后留给下一个连接
+    PoolAllocator<TcpConnection> allocator(eventLoop->getSlabPool());
+    std::shared_ptr<TcpConnection> newConnection = std::allocate_shared<TcpConnection>(allocator,
+                                                                                       connfd,
+                                                                                       peeraddr,
+                                                                                       taskPool_,
+                                                                                       std::move(eventLoop),
+                                                                                       onConnection_,
+                                                                                       onMessage_,
+                                                                                       onWriteComplete_);
+
+    newConnection->setBackpressure(backpressure_);
+    if(highWaterMark_ > 0)
+    {
+        newConnection->setHighWaterMark(highWaterMark_, onHighWaterMark_);
+        newConnection->setLowWaterMark(lowWaterMark_, onLowWaterMark_);
+    }
 
     // 关闭negal算法
     int optval = 1;
     setsockopt(connfd, IPPROTO_TCP, TCP_NODELAY,
                  &optval, static_cast<socklen_t>(sizeof optval));
 
-    // TcpConnection的shared_ptr保存两份：TcpServer、EventLoop各一份
-    connections_[connectionName] = newConnection;
+    return newConnection;
+}
+
+/*
+ *  向ConnectionId对应的连接发送消息
+ *  任意线程都可以调用，只需保存ConnectionId，不必持有TcpConnection的引用；连接已经关闭时消息被丢弃
+ */
+void TcpServer::sendTo(ConnectionId id, std::string message)
+{
+    int loopIndex = connectionIdLoop(id);
+    if(id == 0 || loopIndex >= static_cast<int>(eventLoops_.size()))
+        return;
 
-    // 将新的TcpConnection对象用round Robin方式分配给各个IO EventLoop
-    eventLoops_[nextEventLoop_]->addConnection(std::move(newConnection));
-    nextEventLoop_ = (++nextEventLoop_) >= ioThreadsNum_ ? 0 : nextEventLoop_;
+    eventLoops_[loopIndex]->sendTo(id, std::move(message));
 }
 
 /*
- *  清理列表中已经关闭的TcpConnection对象
+ *  向一批连接广播同一条消息，如聊天室的所有成员
+ *  任意线程都可以调用。接收者按所属EventLoop分组，每个EventLoop只投递一个待办、唤醒一次；
+ *  message只有一份，各连接的output buffer只增加其引用计数，不复制数据
  */
-void TcpServer::cleanTcpConnection()
+void TcpServer::broadcast(const std::vector<ConnectionId>& ids, SharedMessage message)
 {
-    std::vector<std::string> cleans;
-    pthread_mutex_lock(&cleanMutex_);
-    cleans.swap(cleans_);
-    pthread_mutex_unlock(&cleanMutex_);
+    if(!message || ids.empty())
+        return;
 
-    for(const std::string& curClean : cleans)
+    const int loopNum = static_cast<int>(eventLoops_.size());
+    std::vector<std::vector<ConnectionId>> groups(loopNum);
+    for(ConnectionId id : ids)
     {
-        connections_.erase(curClean);
+        int loopIndex = connectionIdLoop(id);
+        if(id != 0 && loopIndex < loopNum)
+            groups[loopIndex].push_back(id);
+    }
+
+    for(int i=0;i < loopNum;++i)
+    {
+        if(!groups[i].empty())
+            eventLoops_[i]->broadcast(std::move(groups[i]), message);
     }
 }
 
+void TcpServer::broadcast(const std::vector<ConnectionId>& ids, std::string message)
+{
+    broadcast(ids, std::make_shared<const std::string>(std::move(message)));
+}
+
 /*
- *  向cleans_[]新增一项内容
- *  供TcpConnection的handleClose()中跨线程调用
+ *  汇总所有IO线程内存池的统计信息
  */
-void TcpServer::addClean(std::string name)
+SlabPool::Stats TcpServer::getSlabPoolStats()
 {
-    pthread_mutex_lock(&cleanMutex_);
-    cleans_.push_back(name);
-    pthread_mutex_unlock(&cleanMutex_);
+    SlabPool::Stats total;
+    memset(&total, 0, sizeof total);
+    for(size_t i=0;i < eventLoops_.size();++i)
+    {
+        SlabPool::Stats stats = eventLoops_[i]->getSlabPool()->getStats();
+        total.hits_      += stats.hits_;
+        total.misses_    += stats.misses_;
+        total.oversize_  += stats.oversize_;
+        total.inUse_     += stats.inUse_;
+        total.slabBytes_ += stats.slabBytes_;
+    }
+    return total;
+}
+
+/*
+ *  所有IO线程合并后的循环延迟
+ */
+void TcpServer::getLoopLag(int stage, LatencyHistogram* result)
+{
+    for(size_t i=0;i < eventLoops_.size();++i)
+        result->merge(eventLoops_[i]->getLagHistogram(stage));
+}
+
+/*
+ *  循环延迟文本报告，每行一个IO线程的一种循环延迟
+ */
+std::string TcpServer::getLoopLagReport()
+{
+    std::string text;
+    for(size_t i=0;i < eventLoops_.size();++i)
+    {
+        for(int stage=0;stage < EventLoop::kLagStageNum;++stage)
+        {
+            std::string name = "loop" + std::to_string(eventLoops_[i]->getLoopIndex()) + "." + EventLoop::lagStageName(stage);
+            text += LatencyRegistry::formatLine(name.c_str(), eventLoops_[i]->getLagHistogram(stage));
+        }
+    }
+    return text;
+}
+
+/*
+ *  线程池任务数降到低水位，通知各IO线程恢复被暂停读的连接
+ *  在线程池的工作线程中调用
+ */
+void TcpServer::resumeThrottledConnections()
+{
+    for(size_t i=0;i < eventLoops_.size();++i)
+        eventLoops_[i]->resumeThrottled();
 }
 
 /*
@@ -197,8 +450,26 @@ void TcpServer::addClean(std::string name)
  */
 void* TcpServer::entryIOThread(void *Data)
 {
-    std::shared_ptr<EventLoop> eventLoop(new EventLoop());
+    std::shared_ptr<EventLoop> eventLoop(new EventLoop(pollerType_));
+    eventLoop->setIdleTimeout(idleTimeout_);
+    eventLoop->setEdgeTriggered(edgeTriggered_);
+
+    // 每个IO线程各自的SO_REUSEPORT listen socket，由内核分配连接
+    if(reusePort_)
+    {
+        int listenfd = createListenSocket(ip_, port_);
+        listen(listenfd,SOMAXCONN);
+        eventLoop->setAcceptor(listenfd,std::bind(&TcpServer::acceptInLoop,this,
+                                                  std::weak_ptr<EventLoop>(eventLoop),
+                                                  std::placeholders::_1,std::placeholders::_2),
+                               maxAcceptsPerWakeup_);
+    }
+
+    pthread_mutex_lock(&eventLoopsMutex_);
+    eventLoop->setLoopIndex(static_cast<int>(eventLoops_.size())); // 在loop()之前确定，之后分配的ConnectionId都带上这个下标
     eventLoops_.push_back(eventLoop);
+    pthread_cond_signal(&eventLoopsCond_);
+    pthread_mutex_unlock(&eventLoopsMutex_);
 
     eventLoop->loop();
 
@@ -216,6 +487,17 @@ void TcpServer::createEventLoopThreadPool()
         newIOThread->startThread();
         ioThreads_.emplace_back(std::move(newIOThread));
     }
+
+    newConnections_.resize(ioThreadsNum_);
+    lastBusyTimeUs_.assign(ioThreadsNum_, 0);
+    recentBusyTimeUs_.assign(ioThreadsNum_, 0);
+    buildHashRing();
+
+    // 等所有IO线程都创建好EventLoop，之后主线程才能分配连接
+    pthread_mutex_lock(&eventLoopsMutex_);
+    while(eventLoops_.size() < static_cast<size_t>(ioThreadsNum_))
+        pthread_cond_wait(&eventLoopsCond_, &eventLoopsMutex_);
+    pthread_mutex_unlock(&eventLoopsMutex_);
 }
 
 /*
@@ -262,36 +544,65 @@ void TcpServer::acceptNewConnection()
         {
             if(events_[i].data.fd == listenfd_)
             {
-                // 接受连接请求
-                struct sockaddr_in peeraddr; // 对等方ip port，网络字节序
-                socklen_t peerlen = sizeof(peeraddr);
-                int connfd = accept4(listenfd_,
-                                      (struct sockaddr *)&peeraddr,
-                                              &peerlen,
-                                              SOCK_NONBLOCK | SOCK_CLOEXEC);
-
-                // fd耗尽处理
-                if (connfd == -1)
+                // 一直accept到EAGAIN，最多maxAcceptsPerWakeup_个，剩下的LT模式下epoll还会再通知
+                for(int accepted=0;accepted < maxAcceptsPerWakeup_;++accepted)
                 {
-                    if (errno == EMFILE)
+                    // 接受连接请求
+                    struct sockaddr_in peeraddr; // 对等方ip port，网络字节序
+                    socklen_t peerlen = sizeof(peeraddr);
+                    int connfd = accept4(listenfd_,
+                                          (struct sockaddr *)&peeraddr,
+                                                  &peerlen,
+                                                  SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+                    if (connfd == -1)
                     {
-                        close(idlefd_);
-                        idlefd_ = accept(listenfd_, NULL, NULL);
-                        close(idlefd_);
-                        idlefd_ = open("/dev/null", O_RDONLY | O_CLOEXEC);
-                        continue;
+                        if (errno == EINTR || errno == ECONNABORTED)
+                            continue;
+
+                        // fd耗尽处理
+                        if (errno == EMFILE)
+                        {
+                            close(idlefd_);
+                            idlefd_ = accept(listenfd_, NULL, NULL);
+                            close(idlefd_);
+                            idlefd_ = open("/dev/null", O_RDONLY | O_CLOEXEC);
+                            continue;
+                        }
+                        break; // EAGAIN，没有更多连接了
                     }
-                }
-
-                // 连接建立时调用回调函数
-                onConnection_((void *)&peeraddr);
 
-                // 创建新的TcpConnection对象，保存至connections_，并分配给IO线程
-                createNewTcpConnection(connfd,peeraddr);
+                    // 创建新的TcpConnection对象，保存至connections_，并暂存到所分配IO线程的newConnections_中
+                    createNewTcpConnection(connfd,peeraddr);
+                }
             }
         }
-        // 根据cleanQueue_来清理connections_中的TcpConnection对象
-        cleanTcpConnection();
+
+        // 把这一轮accept到的连接成批交给各IO线程，每个IO线程只需一个待办和一次wakeup
+        dispatchNewConnections();
     }
 
+}
+
+/*
+ *  创建listen socket：IPV4的TCP，流式，非阻塞，不可继承，设置IP PORT复用，并绑定IP PORT
+ */
+int TcpServer::createListenSocket(in_addr_t ip,const std::string& port)
+{
+    int listenfd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+    int optval = 1;
+    setsockopt(listenfd, SOL_SOCKET, SO_REUSEADDR,
+               &optval, static_cast<socklen_t>(sizeof(optval)));
+    setsockopt(listenfd, SOL_SOCKET, SO_REUSEPORT,
+               &optval, static_cast<socklen_t>(sizeof(optval)));
+
+    struct sockaddr_in tmpData;
+    memset(&tmpData, 0, sizeof tmpData);
+    tmpData.sin_family      = AF_INET;
+    tmpData.sin_port        = htons(atoi(port.c_str()));
+    tmpData.sin_addr.s_addr = ip;
+    bind(listenfd,(struct sockaddr *)&tmpData,sizeof(tmpData));
+
+    return listenfd;
 }
\ No newline at end of file
@@ -3,21 +3,53 @@
 
 #include "ThreadPool.h"
 #include "EventLoop.h"
+#include "LoopWatchdog.h"
 
 namespace base
 {
     /*
      * Tcp服务器类
      * 利用epoll监听listenfd的连接请求，建立新的连接；
-     * 利用name-pointer的K-V对保存TcpConnection列表；
      * 利用unique_ptr保存IO线程对象，shared_ptr保存EventLoop对象；
      * 在创建的IO子线程内部创建EventLoop对象，因此向eventLoops_中存放时是跨线程操作，需要加锁；
-     * 清理TcpConnection对象是在IO线程中，跨线程调用TcpServer::addClean()，向cleans_添加要清除的连接name，
-     * 等下次处理完连接请求后会执行TcpServer::cleanTcpConnection()来清除对象。但并不一定马上析构对象；
+     * TcpConnection对象只由所属EventLoop持有，连接关闭时在IO线程中直接清理，TcpServer不保存连接列表；
+     * 每个连接有一个64位的ConnectionId，高8位是所属EventLoop在eventLoops_中的下标，
+     * 因此TcpServer::sendTo()可以由ConnectionId直接找到EventLoop，再由EventLoop以fd为下标O(1)找到连接；
+     * TcpServer::broadcast()把接收者按所属EventLoop分组，每个EventLoop一个待办，各连接共享同一份消息数据；
+     *
+     * setReusePort(true)时，主线程不再accept：每个IO线程各自创建一个SO_REUSEPORT的listen socket并自己accept，
+     * 由内核在各IO线程间分配新连接，省去“主线程accept -> addConnection -> addPending -> wakeup”的跨线程交接。
+     * server停止时由各EventLoop在退出loop()后关闭自己的连接。
+     * onConnection、onWriteComplete都在IO线程中回调，参数是TcpConnection；连接加入EventLoop、分配好ConnectionId后
+     * 才回调onConnection，断开时再回调一次，用isConnected()区分。
+     *
+     * 主线程accept时，新连接分配给哪个IO线程由LoopSelectPolicy决定：
+     * 轮叫、连接数最少、最近忙碌时间最少、按对等方地址（或setHashKeyFunc()由对等方地址算出的key）一致性哈希。
+     * 一致性哈希让同一个key总是落在同一个IO线程；默认key是对等方ip和端口，同一NAT后或回环地址上的客户端也会分散开。
+     * 注意IO线程在accept时就选定了，此时还不知道用户id、聊天室等登录后才有的信息，连接建立后也不会迁移到别的IO线程，
+     * 因此没法让同一聊天室的成员连接落在同一个IO线程上；登录后可以用getLoopIndexForKey(房间号)选出房间状态归属的IO线程，
+     * 把对房间的操作投递到那里，广播仍由broadcast()按接收者所属IO线程分组。
+     * setReusePort(true)时由内核分配连接，选择策略不起作用。
+     *
+     * 任务线程池的任务数达到上限（setTaskLimit()）时，默认丢弃新任务；
+     * setBackpressure(true)时任务照样投递，同时暂停读产生任务的连接，线程池任务数降到低水位后各IO线程恢复读这些连接。
+     * setHighWaterMark()/setLowWaterMark()给每个连接的输出缓冲设置水位回调，用于限制慢速接收方占用的内存。
+     * setStallThreshold()启动LoopWatchdog，某个IO线程一轮处理超过阈值时回调，指出卡在哪个阶段、哪个连接上；
+     * 各IO线程每轮的处理时间记入循环延迟直方图，由getLoopLag()/getLoopLagReport()读取。
      * */
     class TcpServer : noncopyable
     {
     public:
+        static const int kDefaultMaxAcceptsPerWakeup = 256;
+
+        // 新连接选择IO线程的策略
+        enum LoopSelectPolicy{
+            kRoundRobin = 0,   // 轮叫
+            kLeastConnections, // 当前连接数最少
+            kLeastBusy,        // 最近一段时间处理event和待办的时间最少
+            kConsistentHash    // 按哈希key一致性哈希
+        };
+
         /// 不可跨线程调用
         explicit TcpServer(
                 int taskPoolSize,
@@ -25,14 +57,30 @@ namespace base
                 std::string port,
                 onConnection    onConnectionFunc,
                 onMessage       onMessageFunc,
-                onWriteComplete onWriteCompleteFunc);
+                onWriteComplete onWriteCompleteFunc,
+                Poller::PollerType pollerType = Poller::kEpoll);
         ~TcpServer();
 
         void start();
         void stop();
 
+        void setIdleTimeout(int idleSeconds){ idleTimeout_ = idleSeconds; } // 需在start()前调用，0表示不检测
+        void setEdgeTriggered(bool on){ edgeTriggered_ = on; }             // 需在start()前调用，默认为LT模式
+        void setReusePort(bool on){ reusePort_ = on; }                     // 需在start()前调用，每个IO线程各自accept
+        void setLoopSelectPolicy(LoopSelectPolicy policy){ loopSelectPolicy_ = policy; } // 需在start()前调用
+        void setHashKeyFunc(HashKeyFunc func){ hashKeyFunc_ = std::move(func); }          // 需在start()前调用，默认为对等方ip和端口
+        void setMaxAcceptsPerWakeup(int num){ maxAcceptsPerWakeup_ = num > 0 ? num : 1; } // 需在start()前调用
+        void setTaskLimit(int maxTask, int lowWaterMark){ taskPool_->setMaxTask(maxTask, lowWaterMark); } // 需在start()前调用
+        void setBackpressure(bool on){ backpressure_ = on; } // 需在start()前调用
+        void setHighWaterMark(size_t bytes, onHighWaterMark func){ highWaterMark_ = bytes; onHighWaterMark_ = std::move(func); } // 需在start()前调用
+        void setLowWaterMark(size_t bytes, onLowWaterMark func){ lowWaterMark_ = bytes; onLowWaterMark_ = std::move(func); }    // 需在start()前调用
+        void setStallThreshold(int thresholdMs, onLoopStall func){ stallThresholdMs_ = thresholdMs; onLoopStall_ = std::move(func); } // 需在start()前调用，0表示不检测
+
         void createNewTcpConnection(int connfd,struct sockaddr_in peeraddr);
-        void cleanTcpConnection();
+        int  selectEventLoop(const struct sockaddr_in& peeraddr);
+        int  getLoopIndexForKey(uint64_t key);
+        void dispatchNewConnections();
+        void acceptInLoop(std::weak_ptr<EventLoop> weakEventLoop,int connfd,struct sockaddr_in peeraddr);
 
         void* entryIOThread(void *Data);
 
@@ -40,11 +88,27 @@ namespace base
         void stopEventLoopThreadPool();
 
         /// 可跨线程调用
-        void addClean(std::string name);
+        void sendTo(ConnectionId id, std::string message);
+        void broadcast(const std::vector<ConnectionId>& ids, SharedMessage message);
+        void broadcast(const std::vector<ConnectionId>& ids, std::string message);
+        SlabPool::Stats getSlabPoolStats(); // 所有IO线程内存池的统计之和
+        int getPendingTaskNum(){ return taskPool_->getTaskNum(); } // 任务线程池中还没被取走的任务数
+        void getLoopLag(int stage, LatencyHistogram* result);      // 所有IO线程合并后的循环延迟，stage见EventLoop::LagStage，result需为空
+        std::string getLoopLagReport();                            // 每行一个IO线程的一种循环延迟（us）
 
     private:
         /// 不可跨线程调用
         void acceptNewConnection();
+        std::shared_ptr<TcpConnection> newTcpConnection(int connfd,
+                                                        struct sockaddr_in peeraddr,
+                                                        std::shared_ptr<EventLoop> eventLoop);
+
+        static int createListenSocket(in_addr_t ip,const std::string& port);
+        static uint64_t hashMix(uint64_t key);
+
+        void resumeThrottledConnections();
+        void buildHashRing();
+        int  selectLeastBusy();
 
     private:
         in_addr_t       ip_;       // 监听的ip，默认为 0.0.0.0，即监听所有源ip
@@ -58,19 +122,41 @@ namespace base
 
         std::shared_ptr<ThreadPool> taskPool_; // 任务处理线程池
 
+        int idleTimeout_; // 空闲连接超时秒数，超过这么久没收到数据就主动断开
+        bool edgeTriggered_; // IO线程是否以EPOLLET模式监听连接
+        bool reusePort_;     // 是否由各IO线程用各自的SO_REUSEPORT listen socket直接accept
+        bool backpressure_;  // 线程池饱和时是否暂停读连接，而不是丢弃任务
+        size_t highWaterMark_; // 连接输出缓冲高水位，0表示不检测
+        size_t lowWaterMark_;  // 连接输出缓冲低水位
+        int  stallThresholdMs_; // IO线程一轮处理超过这么久视为卡顿，0表示不检测
+        std::unique_ptr<LoopWatchdog> watchdog_; // IO线程卡顿检测
+        int  maxAcceptsPerWakeup_; // 每次listen socket可读时最多accept的连接数
+        Poller::PollerType pollerType_; // IO线程使用的Poller，io_uring不可用时自动退回epoll
+
+        static const int kVirtualNodesPerLoop = 64;          // 一致性哈希环上每个IO线程的虚拟节点数
+        static const int64_t kBusySampleIntervalUs = 100 * 1000; // 最近忙碌时间的采样周期
+
+        LoopSelectPolicy loopSelectPolicy_; // 新连接选择IO线程的策略
+        HashKeyFunc      hashKeyFunc_;      // 一致性哈希的key
+        std::vector<std::pair<uint64_t,int>> hashRing_; // 一致性哈希环，按哈希值排序的(虚拟节点哈希值, IO线程下标)
+        std::vector<int64_t> lastBusyTimeUs_;   // 上次采样时各IO线程的累计忙碌时间
+        std::vector<int64_t> recentBusyTimeUs_; // 最近一个采样周期内各IO线程的忙碌时间（含按新分配连接的估计值）
+        int64_t lastBusySampleUs_;              // 上次采样的时间
+
         int nextEventLoop_;
         int ioThreadsNum_; // IO线程数量
         std::vector<std::unique_ptr<Thread>>    ioThreads_;  // IO线程对象列表
         std::vector<std::shared_ptr<EventLoop>> eventLoops_; // EventLoop对象列表
+        std::vector<std::vector<std::shared_ptr<TcpConnection>>> newConnections_; // 本轮accept到的连接，按所属IO线程分组
         pthread_mutex_t eventLoopsMutex_;   // EventLoop对象列表的互斥锁
-
-        std::unordered_map<std::string,std::shared_ptr<TcpConnection>> connections_; // TcpConnection列表，name-pointer的K-V对
-        std::vector<std::string> cleans_; // 需要clean的TcpConnection的name
-        pthread_mutex_t cleanMutex_;   // clean队列的互斥锁
+        pthread_cond_t  eventLoopsCond_;    // 等待所有IO线程创建好EventLoop
 
         onConnection    onConnection_;
         onMessage       onMessage_;
         onWriteComplete onWriteComplete_;
+        onHighWaterMark onHighWaterMark_;
+        onLowWaterMark  onLowWaterMark_;
+        onLoopStall     onLoopStall_;
     };
 }
 
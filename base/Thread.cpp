@@ -33,14 +33,17 @@ bool Thread::startThread()
     if(isRunning())
         return false;
 
+    setIdle(); // 先设置状态，子线程一开始检查isRunning()时就能看到
     int ret = pthread_create(&threadId_,
                              nullptr,
                              entryThread,
                              static_cast<void*>(&threadData_));
     if(ret != 0) // 创建失败
+    {
+        setStop();
         return false;
+    }
 
-    setIdle();
     return true;
 }
 
@@ -63,6 +66,21 @@ bool Thread::stopThread()
         return false;
 }
 
+/*
+ *  等待子线程结束并回收资源
+ *  与stopThread()二选一：调用者先用setStopping()通知子线程退出，再调用joinThread()等待，子线程不能被detach过
+ */
+bool Thread::joinThread()
+{
+    if(threadId_ == static_cast<pthread_t>(-1))
+        return false;
+
+    int ret = pthread_join(threadId_, nullptr);
+    threadId_ = static_cast<pthread_t>(-1);
+    setStop(); // 子线程已结束，析构时不再detach
+    return ret == 0;
+}
+
 /****************************************************************************************************************/
 
 /*
@@ -36,6 +36,7 @@ namespace base
 
         bool startThread();
         bool stopThread();
+        bool joinThread();
 
         /// FIXME: 都是系统调用，很耗费资源
         int32_t getStatus(){ return threadStatus_.get(); }
@@ -1,20 +1,78 @@
 #include "ThreadPool.h"
 
+#include <algorithm>
+
 using namespace base;
 
+// 当前线程是哪个线程池的哪个工作线程，工作线程自己投递的任务直接放进自己的队列
+static thread_local ThreadPool* tCurrentPool = nullptr;
+static thread_local int         tCurrentSlot = -1;
+
+/*
+ *  工作线程槽位的构造函数
+ */
+ThreadPool::Worker::Worker()
+    :notified_(false)
+{
+    pthread_mutex_init(&mutex_, nullptr);
+    pthread_cond_init(&cond_, nullptr);
+}
+
+/*
+ *  工作线程槽位的析构函数
+ */
+ThreadPool::Worker::~Worker()
+{
+    pthread_mutex_destroy(&mutex_);
+    pthread_cond_destroy(&cond_);
+}
+
 /*
  *  构造函数
  */
 ThreadPool::ThreadPool(int minThread)
     :running_(false),
     stopping_(false),
-    kminThread_(minThread < kmaxTHREAD_ ? minThread : kmaxTHREAD_)
+    kminThread_(minThread < kmaxTHREAD_ ? minThread : kmaxTHREAD_),
+    maxTask_(kDefaultMaxTask),
+    lowWaterMark_(kDefaultMaxTask / 2),
+    saturated_(false),
+    taskNum_(0),
+    idleNum_(0),
+    manageNotified_(false),
+    threadNum_(0),
+    workersStopping_(false)
 {
-    pthread_cond_init(&taskCond_, nullptr);
     pthread_mutex_init(&taskMutex_, nullptr);
+    pthread_mutex_init(&idleMutex_, nullptr);
+    pthread_mutex_init(&manageMutex_, nullptr);
+
+    // 缩容的定时等待用单调时钟，不受系统时间调整影响
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&manageCond_, &attr);
+    pthread_condattr_destroy(&attr);
+
+    for(int i=0;i < kmaxTHREAD_;++i)
+        workers_.emplace_back(new Worker);
+    pool_.resize(kmaxTHREAD_);
 
     threadData_.threadObj_  = this;
     threadData_.threadFunc_ = std::bind(&ThreadPool::managePool,this,std::placeholders::_1);
+
+    // 指标，已有原子变量维护的数值登记读取函数
+    static std::atomic<int> poolSeq(0);
+    MetricsRegistry& registry = MetricsRegistry::instance();
+    std::string prefix = "threadpool." + std::to_string(poolSeq.fetch_add(1)) + ".";
+    metrics_.tasksAdded_    = registry.counter(prefix + "tasks_added");
+    metrics_.tasksRejected_ = registry.counter(prefix + "tasks_rejected");
+    metrics_.tasksExecuted_ = registry.counter(prefix + "tasks_executed");
+    metrics_.taskWaitUs_    = registry.counter(prefix + "task_wait_us");
+    gaugeIds_.push_back(registry.addGaugeFunc(prefix + "task_queue_depth", std::bind(&ThreadPool::getTaskNum,this)));
+    gaugeIds_.push_back(registry.addGaugeFunc(prefix + "workers", std::bind(&ThreadPool::getThreadNum,this)));
+    gaugeIds_.push_back(registry.addGaugeFunc(prefix + "idle_workers", std::bind(&ThreadPool::getIdleNum,this)));
+    gaugeIds_.push_back(registry.addGaugeFunc(prefix + "busy_workers", std::bind(&ThreadPool::getBusyNum,this)));
 }
 
 /*
@@ -22,10 +80,16 @@ ThreadPool::ThreadPool(int minThread)
  */
 ThreadPool::~ThreadPool()
 {
+    for(int id : gaugeIds_)
+        MetricsRegistry::instance().removeGaugeFunc(id);
+
     stopPool();
+    clearTasks();
 
     pthread_mutex_destroy(&taskMutex_);
-    pthread_cond_destroy(&taskCond_);
+    pthread_mutex_destroy(&idleMutex_);
+    pthread_mutex_destroy(&manageMutex_);
+    pthread_cond_destroy(&manageCond_);
 }
 
 /*
@@ -52,9 +116,9 @@ bool ThreadPool::startPool()
 }
 
 /*
- *  停止线程池，但不会销毁线程对象
+ *  停止线程池
  *  可重复调用
- *  只是通知manage线程停止，会一直等待到停止再退出
+ *  通知manage线程停止，并join等待它回收完所有工作线程
  */
 bool ThreadPool::stopPool()
 {
@@ -62,16 +126,18 @@ bool ThreadPool::stopPool()
     if(!running_)
         return false;
 
+    pthread_mutex_lock(&manageMutex_);
     stopping_ = true; // 通知manage线程关闭
-    pthread_detach(poolThread_);
+    pthread_cond_signal(&manageCond_);
+    pthread_mutex_unlock(&manageMutex_);
 
-    while(running_); // 等待线程结束
+    pthread_join(poolThread_, nullptr); // 等待manage线程结束，此时所有工作线程都已结束
+    running_  = false;
     stopping_ = false; // 便于下一次再启动pool
 
     // 清空task列表，否则有些TcpConnection对象没法销毁，还会有shared_ptr被bind在task函数上
-    // 此时所有任务线程都结束了，由于running_为false，IO线程那边不可能再投入新的task了，因此不需要加锁
-    while(!taskList_.empty())
-        taskList_.pop();
+    // 此时所有任务线程都结束了，由于running_为false，IO线程那边不可能再投入新的task了
+    clearTasks();
 
     return true;
 }
@@ -79,140 +145,189 @@ bool ThreadPool::stopPool()
 /*
  *  添加任务
  *  可跨线程调用
+ *  工作线程投递的任务放进自己的队列，其他线程投递的放进全局队列；然后最多唤醒一个空闲线程
  */
-bool ThreadPool::addTask(Task oneTask)
+bool ThreadPool::addTask(Task oneTask, bool ignoreLimit)
 {
-    if(taskList_.size() >= kmaxTASK_ || !running_)
+    if(!running_)
         return false;
 
-    pthread_mutex_lock(&taskMutex_);
-    taskList_.push(std::move(oneTask));
-    pthread_mutex_unlock(&taskMutex_);
+    if(!ignoreLimit && taskNum_.load(std::memory_order_relaxed) >= maxTask_)
+    {
+        saturated_.store(true, std::memory_order_relaxed);
+        metrics_.tasksRejected_->increment();
+        return false;
+    }
 
-    wakeupAllThread();
+    TaskNode* node = new TaskNode;
+    node->task_      = std::move(oneTask);
+    node->enqueueNs_ = monotonicNanoSeconds();
+    node->readTime_  = LatencyRegistry::currentReadTime();
+    metrics_.tasksAdded_->increment();
+
+    if(tCurrentPool != this || !workers_[tCurrentSlot]->deque_.push(node)) // 自己的队列满了也放进全局队列
+    {
+        pthread_mutex_lock(&taskMutex_);
+        taskList_.push_back(node);
+        pthread_mutex_unlock(&taskMutex_);
+    }
+
+    taskNum_.fetch_add(1, std::memory_order_seq_cst);
+    if(!notifyOneIdle() && threadNum_.load(std::memory_order_relaxed) < kmaxTHREAD_)
+        notifyManager(); // 没有空闲线程可唤醒，让manage线程考虑扩容
 
     return true;
 }
 
+/*
+ *  记为饱和
+ *  与takeTask()中“减任务数 -> 检查saturated_”配对：先置saturated_再检查任务数，
+ *  两边至少有一边看到对方的修改，降到低水位的那一次回调不会丢失
+ */
+void ThreadPool::markSaturated()
+{
+    saturated_.store(true, std::memory_order_seq_cst);
+    if(taskNum_.load(std::memory_order_seq_cst) <= lowWaterMark_ && saturated_.exchange(false) && drainCallback_)
+        drainCallback_();
+}
+
+/*
+ *  设置任务队列最大长度，以及饱和后回调drainCallback_的低水位
+ */
+void ThreadPool::setMaxTask(int maxTask, int lowWaterMark)
+{
+    maxTask_      = maxTask > 0 ? maxTask : 1;
+    lowWaterMark_ = lowWaterMark < maxTask_ ? lowWaterMark : maxTask_ - 1;
+    if(lowWaterMark_ < 0)
+        lowWaterMark_ = 0;
+}
+
 /*
  *  唤醒所有阻塞的线程
  */
 void ThreadPool::wakeupAllThread()
 {
-    pthread_cond_broadcast(&taskCond_);
+    for(int i=0;i < kmaxTHREAD_;++i)
+        notifyWorker(i);
+}
+
+/*
+ *  正在执行任务（不在空闲列表中）的线程数，近似值
+ */
+int ThreadPool::getBusyNum()
+{
+    int busy = threadNum_.load(std::memory_order_relaxed) - idleNum_.load(std::memory_order_relaxed);
+    return busy > 0 ? busy : 0;
 }
 
 /****************************************************************************************************************/
 
 /*
- *  创建并启动新的子线程
+ *  创建并启动新的子线程，占用一个空槽位
  *  不能跨线程调用
  */
 bool ThreadPool::createAndStartNewThread()
 {
-    if(pool_.size() >= kmaxTHREAD_)
-        return false;
+    for(int slot=0;slot < kmaxTHREAD_;++slot)
+    {
+        if(pool_[slot])
+            continue;
 
-    std::unique_ptr<Thread> newThread(new Thread(std::bind(&ThreadPool::threadFunc,this,std::placeholders::_1)));
-    newThread->startThread();
-    pool_.emplace_back(std::move(newThread));
-    return true;
+        std::unique_ptr<Thread> newThread(new Thread(std::bind(&ThreadPool::threadFunc,this,std::placeholders::_1,slot)));
+        newThread->startThread();
+        pool_[slot] = std::move(newThread);
+        return true;
+    }
+    return false;
 }
 
 /*
  *  manage线程主函数
- *  收到stopping通知时，关闭线程池中所有线程，清空线程池队列pool_后再结束manage线程
+ *  睡在manageCond_上，被事件唤醒或缩容定时到期时才扫描一次各线程状态：
+ *  回收已退出的线程；线程不足kminThread_时补足；全都在忙且还有任务时补充一个线程；
+ *  空闲线程持续过多kShrinkDelayMs后停止一个。
+ *  收到stopping通知时，关闭并join所有工作线程后再结束manage线程
  */
 void *ThreadPool::managePool(void *threadPoolData)
 {
-    // 创建线程对象，并启动子线程
-    while(pool_.size() < kminThread_)
-        createAndStartNewThread();
+    workersStopping_.store(false);
 
-    // manage线程loop
-    int bussyNum = 0; // 线程池中正在处理任务的线程数
-    int idleNum  = 0; // 线程池中空闲的线程数
+    pthread_mutex_lock(&manageMutex_);
+    int64_t surplusSince = 0; // 空闲线程开始持续过多的时刻（毫秒），0表示当前不多
     while(!stopping_)
     {
-        bussyNum = 0;
-        idleNum  = 0;
+        manageNotified_.store(false); // 此后的事件都会再次唤醒manage线程
 
-        // 销毁STOP线程对象
-        for(int i=0;i < pool_.size();++i)
+        int bussyNum = 0; // 线程池中正在处理任务的线程数
+        int idleNum  = 0; // 线程池中空闲的线程数
+        reapThreads(bussyNum, idleNum);
+
+        int threadNum = 0; // 占用槽位的线程数，包括正在停止的
+        for(int i=0;i < kmaxTHREAD_;++i)
+            if(pool_[i])
+                ++threadNum;
+
+        // 补足最少线程数
+        while(bussyNum + idleNum < kminThread_ && createAndStartNewThread())
         {
-            switch (pool_[i]->getStatus())
-            {
-                case Thread::BUSSY:
-                    ++bussyNum;
-                    break;
-                case Thread::IDEL:
-                    ++idleNum;
-                    break;
-                case Thread::STOP:
-                    std::iter_swap(pool_.begin()+i,pool_.end()-1);
-                    pool_.pop_back(); // unique_ptr弹出后对象销毁
-                    --i;
-                    break;
-                case Thread::STOPPING:
-                    break;
-                default:
-                    /// FIXME:缺少错误处理
-                    break;
-            }
+            ++idleNum;
+            ++threadNum;
         }
 
-        // 全都在忙，且有多余任务，补充线程
-        if(idleNum == 0)
+        // 全都在忙，且有多余任务，补充线程；新线程开始忙之后如果仍然不够，会再通知manage线程
+        if(idleNum == 0 && taskNum_.load() > 0 && createAndStartNewThread())
         {
-            createAndStartNewThread();
+            ++idleNum;
+            ++threadNum;
         }
+        threadNum_.store(threadNum);
 
-        // 停止多余IDLE线程
-        bool stopSomething = false;
-        for(int i=0;i < pool_.size();++i)
+        // 空闲线程过多时不立即停止，持续kShrinkDelayMs才停止一个，避免负载抖动时反复创建、销毁线程
+        int timeoutMs = -1;
+        if(bussyNum + idleNum > kminThread_ && idleNum > kmaxIDLETHREAD_)
         {
-            // 仅保留最少的线程数
-            if(bussyNum + idleNum <= kminThread_ || idleNum <= kmaxIDLETHREAD_)
-                break;
-
-            if(pool_[i]->isIdle())
+            int64_t now = monotonicMicroSeconds() / 1000;
+            if(surplusSince == 0)
+                surplusSince = now;
+            else if(now - surplusSince >= kShrinkDelayMs)
             {
-                stopSomething = true;
-                pool_[i]->stopThread();
-                --idleNum;
+                stopOneIdleThread();
+                surplusSince = now; // 再停止下一个也要等kShrinkDelayMs
             }
+            timeoutMs = static_cast<int>(kShrinkDelayMs - (now - surplusSince));
+            if(timeoutMs <= 0)
+                timeoutMs = 1;
+        }
+        else
+        {
+            surplusSince = 0;
         }
-        if(stopSomething)
-            wakeupAllThread();
-    }
 
-    // 等待所有子线程停止，销毁线程对象
-    while(!pool_.empty())
-    {
-        for(int i=0;i < pool_.size();++i)
+        if(stopping_)
+            break;
+
+        if(timeoutMs < 0)
+        {
+            pthread_cond_wait(&manageCond_, &manageMutex_);
+        }
+        else
         {
-            switch (pool_[i]->getStatus())
+            struct timespec deadline;
+            clock_gettime(CLOCK_MONOTONIC, &deadline);
+            deadline.tv_sec  += timeoutMs / 1000;
+            deadline.tv_nsec += static_cast<long>(timeoutMs % 1000) * 1000 * 1000;
+            if(deadline.tv_nsec >= 1000 * 1000 * 1000)
             {
-                case Thread::BUSSY:
-                case Thread::IDEL:
-                    pool_[i]->stopThread(); // 通知子线程结束
-                    break;
-                case Thread::STOP:
-                    std::iter_swap(pool_.begin()+i,pool_.end()-1);
-                    pool_.pop_back(); // unique_ptr弹出后对象销毁
-                    --i;
-                    break;
-                case Thread::STOPPING:
-                    break;
-                default:
-                    /// FIXME:缺少错误处理
-                    break;
+                deadline.tv_sec  += 1;
+                deadline.tv_nsec -= 1000 * 1000 * 1000;
             }
+            pthread_cond_timedwait(&manageCond_, &manageMutex_, &deadline);
         }
-        wakeupAllThread(); // 唤醒所有子线程，防止其阻塞在wait处。STOPPING状态的子线程会链式相互唤醒
     }
+    pthread_mutex_unlock(&manageMutex_);
+
+    stopAllThreads();
 
-    running_ = false;
     pthread_exit(nullptr);
 
     return nullptr;
@@ -220,45 +335,303 @@ void *ThreadPool::managePool(void *threadPoolData)
 
 /*
  *  子线程主函数
+ *  找任务的顺序：自己的队列 -> 全局队列 -> 其他线程的队列；都没有就登记空闲并睡眠，等待被单独唤醒
  */
-void* ThreadPool::threadFunc(void *threadData)
+void* ThreadPool::threadFunc(void *threadData, int slot)
 {
     Thread::ThreadData *data = static_cast<Thread::ThreadData *>(threadData);
     Thread *thisThread = data->threadObj_; // 线程对象
+    Worker& worker = *workers_[slot];
 
-    while(thisThread->isRunning())
+    tCurrentPool = this;
+    tCurrentSlot = slot;
+
+    while(thisThread->isRunning() && !workersStopping_.load(std::memory_order_relaxed))
     {
-        thisThread->setIdle();
         // 取任务
-        pthread_mutex_lock(&taskMutex_);
-        while(taskList_.empty())
+        TaskNode* node = takeTask(slot);
+        if(node != nullptr)
         {
-            pthread_cond_wait(&taskCond_, &taskMutex_);
+            // 空闲 -> 忙：还有任务却已经没有空闲线程了，通知manage线程扩容
+            if(thisThread->isIdle()) // 防止STOPPING状态被刷掉
+            {
+                thisThread->setBussy();
+                if(taskNum_.load(std::memory_order_relaxed) > 0 && idleNum_.load(std::memory_order_relaxed) == 0 &&
+                   threadNum_.load(std::memory_order_relaxed) < kmaxTHREAD_)
+                    notifyManager();
+            }
 
-            if(thisThread->isStopping()) // 有可能是结束线程才被唤醒
+            // 执行任务，恢复投递者的消息读取时间，任务中send()的应答就能算出端到端延迟
+            int64_t startNs = 0;
+            if(node->readTime_ != 0 && LatencyRegistry::isEnabled())
+            {
+                startNs = monotonicNanoSeconds();
+                LatencyRegistry::currentReadTime() = node->readTime_;
+            }
+            if(node->task_ != nullptr)
+                node->task_();
+            if(startNs != 0)
             {
-                thisThread->setStop();
-                pthread_mutex_unlock(&taskMutex_); // 结束线程之前先解锁
-                wakeupAllThread(); // 防止抢了其他线程的任务唤醒，所以补一次wakeup；或唤醒其他STOPPING线程
-                pthread_exit(nullptr);
+                LatencyRegistry::record(LatencyRegistry::kTaskRun, monotonicNanoSeconds() - startNs);
+                LatencyRegistry::currentReadTime() = 0;
             }
-            /// FIXME: stop线程后的wakeup信号如果被非STOPPING线程抢到怎么办？
+            delete node;
+            continue;
         }
-        Task curTask = taskList_.front();
-        taskList_.pop();
-        pthread_mutex_unlock(&taskMutex_);
 
-        // 执行任务
-        if(!thisThread->isStopping()) // 防止STOPPING状态被刷掉
-            thisThread->setBussy();
-        if(curTask != nullptr)
-            curTask();
+        // 先登记空闲，再检查一次任务数：与addTask()中“先增加任务数，再检查空闲列表”配对，保证不会丢失唤醒
+        bool becomeIdle = thisThread->isBussy();
+        if(becomeIdle) // 防止STOPPING状态被刷掉
+            thisThread->setIdle();
+        pushIdle(slot);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if(taskNum_.load(std::memory_order_relaxed) > 0)
+        {
+            removeIdle(slot);
+            continue;
+        }
+
+        // 忙 -> 空闲：空闲线程过多，通知manage线程开始缩容计时
+        if(becomeIdle && idleNum_.load(std::memory_order_relaxed) > kmaxIDLETHREAD_ &&
+           threadNum_.load(std::memory_order_relaxed) > kminThread_)
+            notifyManager();
+
+        pthread_mutex_lock(&worker.mutex_);
+        while(!worker.notified_ && thisThread->isRunning() && !workersStopping_.load(std::memory_order_relaxed))
+            pthread_cond_wait(&worker.cond_, &worker.mutex_);
+        worker.notified_ = false;
+        pthread_mutex_unlock(&worker.mutex_);
+
+        removeIdle(slot); // 被addTask()唤醒时已经不在空闲列表中；被stop唤醒时还在
     }
 
+    tCurrentPool = nullptr;
+    tCurrentSlot = -1;
+
+    // 结束前可能刚好被addTask()选中唤醒，把这次唤醒转交给其他空闲线程
+    removeIdle(slot);
+    if(taskNum_.load(std::memory_order_seq_cst) > 0)
+        notifyOneIdle();
+
+    // 设为STOP之后manage线程就可能join并复用这个槽位，之后不能再访问worker和thisThread
     thisThread->setStop();
+    notifyManager();
     pthread_exit(nullptr);
 }
 
+/*
+ *  找一个任务：自己的队列 -> 全局队列（顺便取一小批放进自己的队列） -> 窃取其他线程的队列
+ */
+ThreadPool::TaskNode* ThreadPool::takeTask(int slot)
+{
+    WorkStealingDeque<TaskNode>& deque = workers_[slot]->deque_;
+
+    TaskNode* node = deque.pop();
+    if(node == nullptr)
+    {
+        pthread_mutex_lock(&taskMutex_);
+        if(!taskList_.empty())
+        {
+            node = taskList_.front();
+            taskList_.pop_front();
+            for(int i=1;i < kInjectBatch && !taskList_.empty();++i)
+            {
+                if(!deque.push(taskList_.front()))
+                    break;
+                taskList_.pop_front();
+            }
+        }
+        pthread_mutex_unlock(&taskMutex_);
+    }
+
+    for(int i=1;node == nullptr && i < kmaxTHREAD_;++i)
+        node = workers_[(slot + i) % kmaxTHREAD_]->deque_.steal();
+
+    if(node != nullptr)
+    {
+        metrics_.tasksExecuted_->increment();
+        int64_t waitNs = monotonicNanoSeconds() - node->enqueueNs_;
+        metrics_.taskWaitUs_->add(waitNs / 1000);
+        if(node->readTime_ != 0 && LatencyRegistry::isEnabled())
+            LatencyRegistry::record(LatencyRegistry::kPoolQueue, waitNs);
+
+        // 饱和后降到低水位，由恰好取走这个任务的线程回调一次
+        int remain = taskNum_.fetch_sub(1, std::memory_order_seq_cst) - 1;
+        if(remain <= lowWaterMark_ && saturated_.load(std::memory_order_seq_cst) &&
+           saturated_.exchange(false) && drainCallback_)
+            drainCallback_();
+    }
+    return node;
+}
+
+/*
+ *  登记为空闲线程
+ */
+void ThreadPool::pushIdle(int slot)
+{
+    pthread_mutex_lock(&idleMutex_);
+    idleWorkers_.push_back(slot);
+    idleNum_.store(static_cast<int>(idleWorkers_.size()), std::memory_order_relaxed);
+    pthread_mutex_unlock(&idleMutex_);
+}
+
+/*
+ *  从空闲列表中删除，不在列表中时什么也不做
+ */
+void ThreadPool::removeIdle(int slot)
+{
+    pthread_mutex_lock(&idleMutex_);
+    std::vector<int>::iterator it = std::find(idleWorkers_.begin(), idleWorkers_.end(), slot);
+    if(it != idleWorkers_.end())
+    {
+        idleWorkers_.erase(it);
+        idleNum_.store(static_cast<int>(idleWorkers_.size()), std::memory_order_relaxed);
+    }
+    pthread_mutex_unlock(&idleMutex_);
+}
+
+/*
+ *  从空闲列表中取出一个线程唤醒，没有空闲线程时返回false
+ */
+bool ThreadPool::notifyOneIdle()
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst); // 与调用者之前对taskNum_的修改形成全序
+    if(idleNum_.load(std::memory_order_relaxed) == 0)
+        return false;
+
+    int slot = -1;
+    pthread_mutex_lock(&idleMutex_);
+    if(!idleWorkers_.empty())
+    {
+        slot = idleWorkers_.back(); // 最近睡眠的线程，缓存还是热的
+        idleWorkers_.pop_back();
+        idleNum_.store(static_cast<int>(idleWorkers_.size()), std::memory_order_relaxed);
+    }
+    pthread_mutex_unlock(&idleMutex_);
+
+    if(slot < 0)
+        return false;
+
+    notifyWorker(slot);
+    return true;
+}
+
+/*
+ *  单独唤醒slot上的线程
+ */
+void ThreadPool::notifyWorker(int slot)
+{
+    Worker& worker = *workers_[slot];
+    pthread_mutex_lock(&worker.mutex_);
+    worker.notified_ = true;
+    pthread_cond_signal(&worker.cond_);
+    pthread_mutex_unlock(&worker.mutex_);
+}
+
+/*
+ *  唤醒manage线程
+ *  manage线程处理之前的重复通知直接忽略，不加锁
+ */
+void ThreadPool::notifyManager()
+{
+    if(manageNotified_.exchange(true))
+        return;
+
+    pthread_mutex_lock(&manageMutex_);
+    pthread_cond_signal(&manageCond_);
+    pthread_mutex_unlock(&manageMutex_);
+}
+
+/*
+ *  join并销毁已退出的线程对象，空出槽位；同时统计忙、空闲线程数
+ *  只在manage线程中调用
+ */
+void ThreadPool::reapThreads(int& bussyNum, int& idleNum)
+{
+    for(int i=0;i < kmaxTHREAD_;++i)
+    {
+        if(!pool_[i])
+            continue;
+
+        switch (pool_[i]->getStatus())
+        {
+            case Thread::BUSSY:
+                ++bussyNum;
+                break;
+            case Thread::IDEL:
+                ++idleNum;
+                break;
+            case Thread::STOP:
+                pool_[i]->joinThread(); // 线程已经在退出，不会阻塞
+                pool_[i].reset();       // unique_ptr重置后对象销毁
+                break;
+            case Thread::STOPPING:
+                break;
+            default:
+                /// FIXME:缺少错误处理
+                break;
+        }
+    }
+}
+
+/*
+ *  停止一个空闲线程，只唤醒被停止的那个线程，由它退出时再通知manage线程回收
+ *  只在manage线程中调用
+ */
+bool ThreadPool::stopOneIdleThread()
+{
+    for(int i=kmaxTHREAD_ - 1;i >= 0;--i) // 从后往前，尽量保留低位槽位，窃取时先扫到
+    {
+        if(pool_[i] && pool_[i]->isIdle())
+        {
+            pool_[i]->setStopping(); // 不detach，退出后由reapThreads()join
+            notifyWorker(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ *  通知所有工作线程退出，并join回收
+ *  只在manage线程中调用
+ */
+void ThreadPool::stopAllThreads()
+{
+    workersStopping_.store(true);
+    wakeupAllThread(); // 唤醒所有子线程，防止其阻塞在wait处
+
+    for(int i=0;i < kmaxTHREAD_;++i)
+    {
+        if(!pool_[i])
+            continue;
+
+        pool_[i]->joinThread();
+        pool_[i].reset();
+    }
+    threadNum_.store(0);
+}
+
+/*
+ *  丢弃所有还没执行的任务，只在所有工作线程都已结束时调用
+ */
+void ThreadPool::clearTasks()
+{
+    for(TaskNode* node : taskList_)
+        delete node;
+    taskList_.clear();
+
+    for(int i=0;i < kmaxTHREAD_;++i)
+    {
+        TaskNode* node;
+        while((node = workers_[i]->deque_.steal()) != nullptr)
+            delete node;
+    }
+
+    taskNum_.store(0, std::memory_order_relaxed);
+    saturated_.store(false, std::memory_order_relaxed);
+}
+
 /*
  *  pool线程入口函数
  */
@@ -267,4 +640,4 @@ void *ThreadPool::entryPoolThread(void *Data)
     ThreadPoolData* tmp = static_cast<ThreadPoolData*>(Data);
     tmp->threadFunc_(Data); // 因为ThreadFunc定义为void*(*)(void*)，所以只能传Data不能传tmp
     return nullptr;
-}
\ No newline at end of file
+}
@@ -2,11 +2,35 @@
 #define THREADPOOL_H
 
 #include "Thread.h"
+#include "WorkStealingDeque.h"
+#include "Metrics.h"
+#include "LatencyHistogram.h"
 
 namespace base
 {
     /*
-     *  动态线程池，作为任务线程池使用
+     *  动态线程池，作为任务线程池使用，工作窃取调度
+     *  每个工作线程占用一个固定的槽位，槽位上有一个Chase-Lev双端队列：
+     *  工作线程自己投递的任务（如Strand的续作）放进自己的队列，不碰任何锁；
+     *  IO线程等外部线程投递的任务放进全局队列taskList_（互斥锁保护），工作线程一次从中取一小批到自己的队列。
+     *  自己的队列和全局队列都空了，就按槽位顺序从其他工作线程的队列顶部窃取。
+     *
+     *  没有任务的工作线程登记到空闲列表，在自己槽位的条件变量上睡眠；
+     *  投递任务后只从空闲列表中取出一个线程单独唤醒，不会broadcast惊醒所有线程。
+     *  “登记空闲 -> fence -> 检查任务数”与“增加任务数 -> fence -> 检查空闲列表”配对，保证不会丢失唤醒。
+     *
+     *  manage线程平时睡在条件变量上，不轮询：
+     *  投递任务时没有空闲线程可唤醒、工作线程退出、停止线程池这几种事件才会唤醒它，据此增减线程，线程数在kminThread_和kmaxTHREAD_之间。
+     *  扩容是立即的；缩容带滞后：空闲线程数持续超过kmaxIDLETHREAD_达kShrinkDelayMs才停止一个，
+     *  此时manage线程用定时等待，其余时候无限期等待，线程池空闲时不消耗CPU。
+     *  被停止的工作线程由manage线程join回收，stopPool()也是join manage线程，不再自旋等待。
+     *
+     *  任务数达到maxTask_时addTask()拒绝任务（ignoreLimit除外），并记为饱和；
+     *  饱和后工作线程取走任务使任务数降到lowWaterMark_时，回调一次drainCallback_，上层据此恢复被暂停的生产者（见TcpServer::setBackpressure()）。
+     *  以ignoreLimit投递的生产者（如Strand）不会被拒绝，发现isFull()而暂停自己时要调用markSaturated()，否则不会有这次回调。
+     *
+     *  指标在MetricsRegistry中以“threadpool.<序号>.”为前缀，序号按线程池创建顺序从0开始。
+     *  由消息触发的任务（投递时线程局部的“当前读取时间”不为0）还会记入LatencyRegistry的pool_queue、task_run阶段。
      * */
     class ThreadPool : noncopyable
     {
@@ -24,36 +48,109 @@ namespace base
 
         bool startPool();
         bool stopPool();
-        bool addTask(Task oneTask);
+        bool addTask(Task oneTask, bool ignoreLimit = false); // ignoreLimit为true时不受maxTask_限制，用于不能丢弃的任务
+
+        void setMaxTask(int maxTask, int lowWaterMark); // 需在startPool()前调用
+        void setDrainCallback(Task func){ drainCallback_ = std::move(func); } // 需在startPool()前调用，在工作线程中回调
+        int  getMaxTask(){ return maxTask_; }
+        int  getTaskNum(){ return taskNum_.load(std::memory_order_relaxed); } // 已投递但还没被取走的任务数
+        bool isFull(){ return taskNum_.load(std::memory_order_relaxed) >= maxTask_; }
+        void markSaturated(); // 记为饱和，降到低水位时回调drainCallback_；已经在低水位及以下时直接回调
+        int  getThreadNum(){ return threadNum_.load(std::memory_order_relaxed); } // 当前线程数
+        int  getIdleNum(){ return idleNum_.load(std::memory_order_relaxed); }     // 正在睡眠的线程数
+        int  getBusyNum();
 
         void wakeupAllThread();
 
         /// 不可跨线程调用
         bool createAndStartNewThread();
         void* managePool(void *threadPoolData);
-        void* threadFunc(void *threadData);
+        void* threadFunc(void *threadData, int slot);
 
     private:
+        // 任务节点，在各队列之间传递指针
+        struct TaskNode
+        {
+            Task    task_;
+            int64_t enqueueNs_; // 投递时间，用于统计任务等待时间
+            int64_t readTime_;  // 投递者当时正在处理的消息的读取时间，执行任务时恢复，见LatencyRegistry
+        };
+
+        // 线程池的指标
+        struct PoolMetrics
+        {
+            std::shared_ptr<Counter> tasksAdded_;    // 投递成功的任务数
+            std::shared_ptr<Counter> tasksRejected_; // 因任务数达到maxTask_被拒绝的任务数
+            std::shared_ptr<Counter> tasksExecuted_; // 执行的任务数
+            std::shared_ptr<Counter> taskWaitUs_;    // 任务从投递到被取走的等待时间之和，除以tasksExecuted_即平均等待时间
+        };
+
+        // 一个工作线程槽位
+        struct Worker
+        {
+            Worker();
+            ~Worker();
+
+            WorkStealingDeque<TaskNode> deque_; // 本线程的任务队列
+            pthread_mutex_t mutex_;             // 以下用于单独唤醒本线程
+            pthread_cond_t  cond_;
+            bool            notified_;
+        };
+
+        static const int kInjectBatch = 8; // 每次从全局队列最多取走的任务数
+        static const int kShrinkDelayMs = 1000; // 空闲线程持续过多这么久才停止一个
+
         /// 不可跨线程调用
         static void *entryPoolThread(void *);
 
+        TaskNode* takeTask(int slot);
+        void pushIdle(int slot);
+        void removeIdle(int slot);
+        bool notifyOneIdle();
+        void notifyWorker(int slot);
+        void notifyManager();
+        void reapThreads(int& bussyNum, int& idleNum);
+        bool stopOneIdleThread();
+        void stopAllThreads();
+        void clearTasks();
+
     private:
-        const int kmaxTASK_   = 40;    // 任务队列最大长度
+        static const int kDefaultMaxTask = 40; // 任务队列默认最大长度
+
         const int kmaxTHREAD_ = 20;    // 线程池最大容量
         const int kmaxIDLETHREAD_ = 3; //最多容许的idle线程数
         const int kminThread_;         // 线程池中线程对象最小数量
 
-        pthread_cond_t  taskCond_;    // 任务队列的条件变量
-        pthread_mutex_t taskMutex_;   // 任务队列的互斥锁
+        int  maxTask_;      // 任务队列最大长度
+        int  lowWaterMark_; // 饱和后任务数降到这么多时回调drainCallback_
+        Task drainCallback_;
+        std::atomic<bool> saturated_; // addTask()因任务数达到maxTask_拒绝过任务，还没降到低水位
+
+        pthread_mutex_t taskMutex_;       // 全局队列的互斥锁
+        std::deque<TaskNode*> taskList_;  // 全局队列，外部线程投递的任务，读写需要加锁
+        std::atomic<int> taskNum_;        // 已投递但还没被工作线程取走的任务数（所有队列之和）
+
+        pthread_mutex_t  idleMutex_;    // 空闲列表的互斥锁
+        std::vector<int> idleWorkers_;  // 正在睡眠的工作线程槽位
+        std::atomic<int> idleNum_;      // idleWorkers_的大小，投递任务时先无锁地看一眼
+
+        PoolMetrics      metrics_;     // 指标
+        std::vector<int> gaugeIds_;    // 在MetricsRegistry中登记的读取函数
+
+        std::vector<std::unique_ptr<Worker> > workers_; // 各槽位，大小为kmaxTHREAD_
+        std::vector<std::unique_ptr<Thread> > pool_;    // 各槽位上的线程对象，空位为nullptr，必须只能在manage线程中使用
 
-        std::vector<std::unique_ptr<Thread> > pool_;   // 线程对象，必须只能在manage线程中使用
-        std::queue<Task> taskList_;   // 任务队列，读写需要加锁
+        pthread_mutex_t   manageMutex_;    // 以下用于唤醒manage线程
+        pthread_cond_t    manageCond_;     // 使用CLOCK_MONOTONIC计时
+        std::atomic<bool> manageNotified_; // 已经唤醒过manage线程但它还没处理，避免重复加锁唤醒
+        std::atomic<int>  threadNum_;      // 当前线程数，由manage线程更新
+        std::atomic<bool> workersStopping_; // 通知所有工作线程退出，线程池停止时使用
 
         pthread_t      poolThread_; // 线程池manage线程
         ThreadPoolData threadData_; // 线程信息
 
         bool running_;  // 线程池是否正在运行
-        bool stopping_; // 通知manage线程关闭
+        bool stopping_; // 通知manage线程关闭，读写需要加manageMutex_
     };
 
 } // namespace base
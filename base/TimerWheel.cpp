@@ -0,0 +1,307 @@
+#include "TimerWheel.h"
+
+using namespace base;
+
+/*
+ *  构造函数
+ */
+TimerWheel::TimerWheel():
+        timerfd_(::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)),
+        armed_(false),
+        currentTick_(0),
+        timerNum_(0)
+{
+    for(int i=0;i < kSlotNum;++i)
+        slots_[i] = -1;
+}
+
+/*
+ *  析构函数
+ */
+TimerWheel::~TimerWheel()
+{
+    close(timerfd_);
+}
+
+/*
+ *  delayMs毫秒后执行一次func，精度为一个tick
+ */
+TimerId TimerWheel::runAfter(int delayMs, TimerCallback func)
+{
+    return addTimer(msToTicks(delayMs), 0, std::move(func));
+}
+
+/*
+ *  每隔intervalMs毫秒执行一次func，直到被cancel
+ */
+TimerId TimerWheel::runEvery(int intervalMs, TimerCallback func)
+{
+    int64_t interval = msToTicks(intervalMs);
+    if(interval < 1)
+        interval = 1;
+    return addTimer(interval, interval, std::move(func));
+}
+
+/*
+ *  ticks个tick后执行一次func
+ */
+TimerId TimerWheel::runAfterTicks(int64_t ticks, TimerCallback func)
+{
+    return addTimer(ticks, 0, std::move(func));
+}
+
+/*
+ *  取消定时器
+ *  TimerId已经失效（已执行完的一次性定时器、已取消的定时器）时什么也不做，可以在定时器回调中取消自身
+ */
+void TimerWheel::cancel(TimerId timerId)
+{
+    int index = static_cast<int>(timerId & 0xffffffff) - 1;
+    uint32_t generation = static_cast<uint32_t>(timerId >> 32);
+    if(index < 0 || index >= static_cast<int>(nodes_.size()) || nodes_[index].generation_ != generation)
+        return;
+
+    if(nodes_[index].slot_ >= 0)
+        unlinkNode(index);
+    releaseNode(index); // 正在执行的定时器不在任何槽中，回收后generation改变，tick()就不会再重新挂入
+}
+
+/*
+ *  timerfd可读事件回调
+ *  读出到期次数，逐个tick推进时间轮；轮中没有定时器时停止timerfd
+ */
+void TimerWheel::handleRead()
+{
+    uint64_t expirations = 0;
+    ssize_t n = ::read(timerfd_, &expirations, sizeof expirations);
+    if(n != sizeof expirations)
+        return;
+
+    for(uint64_t i=0;i < expirations;++i)
+        tick();
+
+    if(timerNum_ == 0)
+        disarmTimerfd();
+}
+
+/****************************************************************************************************************/
+
+/*
+ *  分配定时器节点并挂入时间轮
+ */
+TimerId TimerWheel::addTimer(int64_t ticks, int64_t interval, TimerCallback func)
+{
+    int index;
+    if(!freeNodes_.empty())
+    {
+        index = freeNodes_.back();
+        freeNodes_.pop_back();
+    }
+    else
+    {
+        index = static_cast<int>(nodes_.size());
+        TimerNode node;
+        node.generation_ = 0;
+        nodes_.push_back(std::move(node));
+    }
+
+    TimerNode& node = nodes_[index];
+    node.expire_   = currentTick_ + (ticks < 0 ? 0 : ticks);
+    node.interval_ = interval;
+    node.slot_     = -1;
+    node.func_     = std::move(func);
+    insertNode(index);
+
+    if(++timerNum_ == 1)
+        armTimerfd();
+
+    return (static_cast<TimerId>(node.generation_) << 32) | static_cast<TimerId>(index + 1);
+}
+
+/*
+ *  根据到期tick与当前tick的距离，把节点挂到对应层的槽中
+ */
+void TimerWheel::insertNode(int index)
+{
+    TimerNode& node = nodes_[index];
+    int64_t expire = node.expire_;
+    int64_t idx    = expire - currentTick_;
+    int slot;
+
+    if(idx < 0) // 已经过期，挂到下一个要处理的槽
+    {
+        slot = static_cast<int>(currentTick_ & (kRootSize - 1));
+    }
+    else if(idx < kRootSize)
+    {
+        slot = static_cast<int>(expire & (kRootSize - 1));
+    }
+    else
+    {
+        // 超出最大范围的按最大范围处理
+        const int64_t kMaxRange = (static_cast<int64_t>(1) << (kRootBits + kLevels * kLevelBits)) - 1;
+        if(idx > kMaxRange)
+        {
+            expire = currentTick_ + kMaxRange;
+            idx    = kMaxRange;
+            node.expire_ = expire;
+        }
+
+        int level = 0;
+        while(idx >= (static_cast<int64_t>(1) << (kRootBits + (level + 1) * kLevelBits)))
+            ++level;
+        slot = kRootSize + level * kLevelSize +
+               static_cast<int>((expire >> (kRootBits + level * kLevelBits)) & (kLevelSize - 1));
+    }
+
+    linkNode(index, slot);
+}
+
+/*
+ *  把节点插到槽链表头部
+ */
+void TimerWheel::linkNode(int index, int slot)
+{
+    TimerNode& node = nodes_[index];
+    node.slot_ = slot;
+    node.prev_ = -1;
+    node.next_ = slots_[slot];
+    if(slots_[slot] != -1)
+        nodes_[slots_[slot]].prev_ = index;
+    slots_[slot] = index;
+}
+
+/*
+ *  把节点从所在槽链表中摘下
+ */
+void TimerWheel::unlinkNode(int index)
+{
+    TimerNode& node = nodes_[index];
+    if(node.prev_ != -1)
+        nodes_[node.prev_].next_ = node.next_;
+    else
+        slots_[node.slot_] = node.next_;
+    if(node.next_ != -1)
+        nodes_[node.next_].prev_ = node.prev_;
+    node.slot_ = -1;
+    node.prev_ = -1;
+    node.next_ = -1;
+}
+
+/*
+ *  回收节点，generation加1使旧的TimerId失效
+ */
+void TimerWheel::releaseNode(int index)
+{
+    TimerNode& node = nodes_[index];
+    ++node.generation_;
+    node.slot_ = -1;
+    node.func_ = nullptr; // 尽早释放回调中bind的对象
+    freeNodes_.push_back(index);
+    --timerNum_;
+}
+
+/*
+ *  把第level层（从0开始，不含根层）第index个槽中的定时器重新挂入时间轮，返回index
+ */
+int TimerWheel::cascade(int level, int index)
+{
+    int slot = kRootSize + level * kLevelSize + index;
+    int cur  = slots_[slot];
+    slots_[slot] = -1;
+
+    while(cur != -1)
+    {
+        int next = nodes_[cur].next_;
+        nodes_[cur].slot_ = -1;
+        insertNode(cur);
+        cur = next;
+    }
+    return index;
+}
+
+/*
+ *  推进一个tick，执行到期的定时器
+ */
+void TimerWheel::tick()
+{
+    int index = static_cast<int>(currentTick_ & (kRootSize - 1));
+
+    // 根层转完一圈，从高层降级定时器；只有当前层也转完一圈时才继续降级更高一层
+    if(index == 0)
+    {
+        for(int level=0;level < kLevels;++level)
+        {
+            int levelIndex = static_cast<int>((currentTick_ >> (kRootBits + level * kLevelBits)) & (kLevelSize - 1));
+            if(cascade(level, levelIndex) != 0)
+                break;
+        }
+    }
+
+    // 把到期的链表整体挪到kExpiringSlot，回调中新增的定时器就不会挂到正在处理的链表上
+    int cur = slots_[index];
+    slots_[index] = -1;
+    slots_[kExpiringSlot] = cur;
+    for(;cur != -1;cur = nodes_[cur].next_)
+        nodes_[cur].slot_ = kExpiringSlot;
+
+    ++currentTick_;
+
+    while(slots_[kExpiringSlot] != -1)
+    {
+        int expired = slots_[kExpiringSlot];
+        unlinkNode(expired);
+
+        // 回调中可能新增定时器导致nodes_扩容，因此先把回调取出来再执行
+        TimerCallback func;
+        func.swap(nodes_[expired].func_);
+        uint32_t generation = nodes_[expired].generation_;
+
+        func();
+
+        // 回调中已经cancel了自身
+        if(nodes_[expired].generation_ != generation)
+            continue;
+
+        if(nodes_[expired].interval_ > 0)
+        {
+            nodes_[expired].func_.swap(func);
+            nodes_[expired].expire_ += nodes_[expired].interval_;
+            insertNode(expired);
+        }
+        else
+        {
+            releaseNode(expired);
+        }
+    }
+}
+
+/*
+ *  以kTickMs为周期启动timerfd
+ */
+void TimerWheel::armTimerfd()
+{
+    if(armed_)
+        return;
+
+    struct itimerspec spec;
+    spec.it_interval.tv_sec  = kTickMs / 1000;
+    spec.it_interval.tv_nsec = (kTickMs % 1000) * 1000 * 1000;
+    spec.it_value = spec.it_interval;
+    ::timerfd_settime(timerfd_, 0, &spec, nullptr);
+    armed_ = true;
+}
+
+/*
+ *  停止timerfd
+ */
+void TimerWheel::disarmTimerfd()
+{
+    if(!armed_)
+        return;
+
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof spec);
+    ::timerfd_settime(timerfd_, 0, &spec, nullptr);
+    armed_ = false;
+}
@@ -0,0 +1,84 @@
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include "noncopyable.h"
+#include "Types.h"
+
+namespace base
+{
+    /*
+     *  分层时间轮，每个EventLoop一个
+     *  由timerfd驱动，每个tick为kTickMs毫秒。只有轮中存在定时器时才会启动timerfd，空闲时不会产生额外的唤醒。
+     *  共5层：第0层256个槽，每槽1个tick；第1~4层各64个槽，每槽的跨度是下一层一整圈，可覆盖2^32个tick。
+     *  定时器按到期tick挂到对应层的槽中，低层转完一圈时把高层对应槽中的定时器“降级”重新挂到低层（cascade）。
+     *  runAfter()/runEvery()/cancel()都是O(1)：定时器节点存放在nodes_中，槽内用下标组成双向链表，
+     *  TimerId由节点下标和节点的generation组成，节点被回收复用后旧的TimerId自然失效。
+     *
+     *  定时器本身不产生系统调用，因此可以给每个TcpConnection都挂一个定时器（见EventLoop的空闲连接检测）。
+     *  所有接口都不可跨线程调用，其他线程需要通过EventLoop::addPending()转到IO线程中调用。
+     * */
+    class TimerWheel : noncopyable
+    {
+    public:
+        static const int kTickMs = 10; // 每个tick的毫秒数
+
+        /// 不可跨线程调用
+        explicit TimerWheel();
+        ~TimerWheel();
+
+        int getFd(){ return timerfd_; }
+        int64_t now(){ return currentTick_; } // 当前tick计数，可作为粗粒度的单调时钟
+
+        TimerId runAfter(int delayMs, TimerCallback func);
+        TimerId runEvery(int intervalMs, TimerCallback func);
+        TimerId runAfterTicks(int64_t ticks, TimerCallback func);
+        void cancel(TimerId timerId);
+
+        void handleRead();
+
+        static int64_t msToTicks(int ms){ return ms <= 0 ? 0 : (ms + kTickMs - 1) / kTickMs; }
+
+    private:
+        // 定时器节点，prev_/next_是所在槽链表中的前后节点下标
+        struct TimerNode
+        {
+            int64_t       expire_;     // 到期tick
+            int64_t       interval_;   // 重复间隔，0表示一次性定时器
+            uint32_t      generation_; // 节点每次被回收时加1，用于识别过期的TimerId
+            int           slot_;       // 所在槽下标，-1表示不在任何槽中
+            int           prev_;
+            int           next_;
+            TimerCallback func_;
+        };
+
+        static const int kRootBits  = 8;
+        static const int kLevelBits = 6;
+        static const int kRootSize  = 1 << kRootBits;
+        static const int kLevelSize = 1 << kLevelBits;
+        static const int kLevels    = 4; // 除第0层外的层数
+        static const int kExpiringSlot = kRootSize + kLevels * kLevelSize; // 正在执行的定时器临时挂在这个槽里
+        static const int kSlotNum   = kExpiringSlot + 1;
+
+        TimerId addTimer(int64_t ticks, int64_t interval, TimerCallback func);
+        void insertNode(int index);
+        void linkNode(int index, int slot);
+        void unlinkNode(int index);
+        void releaseNode(int index);
+        int  cascade(int level, int index);
+        void tick();
+        void armTimerfd();
+        void disarmTimerfd();
+
+    private:
+        int  timerfd_;    // 驱动时间轮的timerfd
+        bool armed_;      // timerfd是否已启动
+        int64_t currentTick_; // 下一个要处理的tick
+        int  timerNum_;   // 轮中的定时器数量
+
+        std::vector<TimerNode> nodes_; // 定时器节点，用下标相互引用，扩容不影响链表
+        std::vector<int> freeNodes_;   // 可复用的节点下标
+        int slots_[kSlotNum];          // 各槽链表头节点下标，-1表示空
+    };
+}
+
+#endif //TIMERWHEEL_H
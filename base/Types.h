@@ -7,6 +7,7 @@
 #include <unordered_map>
 #include <memory>
 #include <queue>
+#include <atomic>
 
 #include <functional>
 #include <fcntl.h>
@@ -19,6 +20,7 @@
 #include <sys/syscall.h>
 #include <sys/eventfd.h>
 #include <sys/epoll.h>
+#include <sys/timerfd.h>
 
 #include <netinet/in.h>
 #include <netinet/ip.h>
@@ -27,6 +29,7 @@
 
 #include <signal.h>
 #include <unistd.h>
+#include <time.h>
 #include <assert.h>
 #include <pthread.h>
 
@@ -41,19 +44,59 @@ namespace base
     class Buffer;
     class TcpConnection;
 
-    using onConnection     = std::function<void(void*)>;                            // 连接建立、断开回调函数
+    using onConnection     = std::function<void(const std::shared_ptr<TcpConnection>)>; // 连接建立、断开回调函数，用isConnected()区分，此时已分配ConnectionId
     using onMessage        = std::function<void(const std::shared_ptr<TcpConnection>,
                                                 Buffer *,
                                                 struct sockaddr_in)>;               // 消息到来回调函数
-    using onWriteComplete  = std::function<void(struct sockaddr_in)>;               // 消息发送完毕回调函数
-    using onCleanTcpSever  = std::function<void(std::string)>;                      // Tcp连接关闭时，清理TcpServer::connections_的回调
+    using onWriteComplete  = std::function<void(const std::shared_ptr<TcpConnection>)>; // 消息发送完毕回调函数
+    using onHighWaterMark  = std::function<void(const std::shared_ptr<TcpConnection>,
+                                                size_t)>;                           // 输出缓冲超过高水位回调函数，参数为当前输出缓冲字节数
+    using onLowWaterMark   = std::function<void(const std::shared_ptr<TcpConnection>)>; // 输出缓冲降到低水位回调函数
     using onCleanEventLoop = std::function<void(int)>;                              // Tcp连接关闭时，清理EventLoop::connections_的回调，并取消监听
+    using onNewConnection  = std::function<void(int,struct sockaddr_in)>;           // IO线程自己accept到新连接时的回调
+    using HashKeyFunc      = std::function<uint64_t(const struct sockaddr_in&)>;   // 一致性哈希选择IO线程时，从对等方地址得到哈希key；accept时调用，拿不到登录后的用户id
 
     using PendingFunc = std::function<void()>;       // IO线程待办函数
     using ThreadFunc  = std::function<void*(void*)>; // 工作线程主函数
     using Task        = std::function<void()>;       // 任务函数
 
+    using TimerCallback = std::function<void()>; // 定时器回调函数
+    using TimerId       = uint64_t;              // 定时器标识，高32位为generation，低32位为节点下标+1，0表示无效
+    using SharedMessage = std::shared_ptr<const std::string>; // 可被多个连接共享、发送期间不复制的消息
+    using ConnectionId  = uint64_t;              // 连接标识，高8位为IO线程下标，中间32位为generation，低24位为fd，0表示无效
+    using onLoopStall   = std::function<void(int,int,ConnectionId,int64_t)>;    // EventLoop一轮处理超过阈值的回调，参数为IO线程下标、所处阶段（EventLoop::LoopPhase）、正在处理的连接（0表示没有）、已持续的ms
+
     const int kMicroSecondsPerSecond = 1000 * 1000;
+    const int kMaxConnectionLoops    = 1 << 8;  // ConnectionId能表示的IO线程数
+    const int kMaxConnectionFd       = 1 << 24; // ConnectionId能表示的fd上限，远大于内核默认的nr_open
+
+    // 由IO线程下标、generation、fd组成ConnectionId
+    // generation为32位：内核总是分配最小的空闲fd，连接频繁建立断开时同一个fd很快被反复复用，16位几分钟就会绕回
+    inline ConnectionId makeConnectionId(int loopIndex, uint32_t generation, int fd)
+    {
+        return (static_cast<ConnectionId>(loopIndex & 0xff) << 56) |
+               (static_cast<ConnectionId>(generation) << 24) |
+               static_cast<ConnectionId>(static_cast<uint32_t>(fd) & 0xffffff);
+    }
+    inline int      connectionIdLoop(ConnectionId id){ return static_cast<int>(id >> 56); }
+    inline uint32_t connectionIdGeneration(ConnectionId id){ return static_cast<uint32_t>(id >> 24); }
+    inline int      connectionIdFd(ConnectionId id){ return static_cast<int>(id & 0xffffff); }
+
+    // 单调时钟的当前时间，以us为单位，只用于计算时间间隔
+    inline int64_t monotonicMicroSeconds()
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<int64_t>(ts.tv_sec) * kMicroSecondsPerSecond + ts.tv_nsec / 1000;
+    }
+
+    // 单调时钟的当前时间，以ns为单位，用于统计延迟
+    inline int64_t monotonicNanoSeconds()
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<int64_t>(ts.tv_sec) * 1000 * 1000 * 1000 + ts.tv_nsec;
+    }
 }
 
 #endif //TYPES_H
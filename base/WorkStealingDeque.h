@@ -0,0 +1,98 @@
+#ifndef WORKSTEALINGDEQUE_H
+#define WORKSTEALINGDEQUE_H
+
+#include "noncopyable.h"
+#include "Types.h"
+
+namespace base
+{
+    /*
+     *  定长的Chase-Lev工作窃取双端队列，存放T*
+     *  所有者线程在底部push()/pop()（后进先出，缓存友好），其他线程在顶部steal()（先进先出）。
+     *  所有者的push()/pop()通常只有普通读写和一次fence，只有与窃取者争抢最后一个元素时才用CAS；
+     *  steal()用CAS移动top_，失败说明被别人抢走了，返回nullptr。
+     *  容量固定为kCapacity，满了push()返回false，由调用者另行处理（如放进线程池的全局队列）。
+     *
+     *  push()/pop()只能在所有者线程调用；steal()/empty()可跨线程调用。
+     * */
+    template<typename T>
+    class WorkStealingDeque : noncopyable
+    {
+    public:
+        static const int64_t kCapacity = 1024; // 必须是2的幂
+
+        explicit WorkStealingDeque()
+                : top_(0),
+                  bottom_(0)
+        {
+            for(int64_t i=0;i < kCapacity;++i)
+                buffer_[i].store(nullptr, std::memory_order_relaxed);
+        }
+
+        /// 不可跨线程调用
+        bool push(T* item)
+        {
+            int64_t bottom = bottom_.load(std::memory_order_relaxed);
+            int64_t top    = top_.load(std::memory_order_acquire);
+            if(bottom - top >= kCapacity)
+                return false;
+
+            buffer_[bottom & (kCapacity - 1)].store(item, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            bottom_.store(bottom + 1, std::memory_order_relaxed);
+            return true;
+        }
+
+        T* pop()
+        {
+            int64_t bottom = bottom_.load(std::memory_order_relaxed) - 1;
+            bottom_.store(bottom, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t top = top_.load(std::memory_order_relaxed);
+
+            if(top > bottom) // 空的
+            {
+                bottom_.store(bottom + 1, std::memory_order_relaxed);
+                return nullptr;
+            }
+
+            T* item = buffer_[bottom & (kCapacity - 1)].load(std::memory_order_relaxed);
+            if(top == bottom) // 最后一个元素，要和窃取者抢
+            {
+                if(!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                    item = nullptr;
+                bottom_.store(bottom + 1, std::memory_order_relaxed);
+            }
+            return item;
+        }
+
+        /// 可跨线程调用
+        T* steal()
+        {
+            int64_t top = top_.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t bottom = bottom_.load(std::memory_order_acquire);
+            if(top >= bottom)
+                return nullptr;
+
+            T* item = buffer_[top & (kCapacity - 1)].load(std::memory_order_relaxed);
+            if(!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                return nullptr;
+            return item;
+        }
+
+        // 近似值，只用于判断要不要去窃取
+        bool empty() const
+        {
+            return bottom_.load(std::memory_order_acquire) <= top_.load(std::memory_order_acquire);
+        }
+
+    private:
+        std::atomic<int64_t> top_;    // 窃取者取的位置
+        char pad_[64];                // 隔开所有者和窃取者访问的变量，避免伪共享
+        std::atomic<int64_t> bottom_; // 所有者push/pop的位置
+        std::atomic<T*> buffer_[kCapacity];
+    };
+}
+
+#endif //WORKSTEALINGDEQUE_H
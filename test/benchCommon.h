@@ -0,0 +1,363 @@
+#ifndef BENCHCOMMON_H
+#define BENCHCOMMON_H
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <getopt.h>
+#include <iostream>
+#include <thread>
+#include <deque>
+#include <algorithm>
+
+#include "../base/TcpServer.h"
+#include "../base/LatencyHistogram.h"
+
+/*
+ *  benchEcho、benchPingPong共用的部分
+ *  同一进程中启动一个echo TcpServer，再由若干客户端线程经回环地址建立N个连接，
+ *  每个连接保持depth条消息在途：收齐一条的回显就记下往返延迟，再发一条；到时间后统计。
+ *  depth为1即ping-pong，测延迟；depth大于1时流水线发送，测吞吐。
+ */
+
+namespace bench
+{
+    using namespace base;
+
+    // 命令行参数
+    struct Options
+    {
+        int  ioThreads_;     // -t 服务器IO线程数
+        int  connections_;   // -c 连接数
+        int  messageSize_;   // -s 消息字节数
+        int  depth_;         // -n 每个连接在途的消息数
+        int  seconds_;       // -d 测试秒数
+        int  clientThreads_; // -w 客户端线程数
+        bool edgeTriggered_; // -e 服务器以ET模式监听连接
+        bool ioUring_;       // -u 服务器用io_uring
+        bool reusePort_;     // -r 服务器各IO线程各自accept
+        bool usePool_;       // -P 回显经过任务线程池，而不是在IO线程中直接发送
+        bool loopLag_;       // -l 结束时打印服务器各IO线程的循环延迟
+        std::string host_;   // -h 只作客户端，连接已有的服务器
+        std::string port_;   // -p 端口
+    };
+
+    inline void usage(const char* name, const Options& options)
+    {
+        std::cerr << "用法：" << name << " [-t IO线程数，默认" << options.ioThreads_ << "]"
+                  << " [-c 连接数，默认" << options.connections_ << "]"
+                  << " [-s 消息字节数，默认" << options.messageSize_ << "]"
+                  << " [-n 每个连接在途消息数，默认" << options.depth_ << "]"
+                  << " [-d 秒数，默认" << options.seconds_ << "]"
+                  << " [-w 客户端线程数，默认" << options.clientThreads_ << "]"
+                  << " [-e ET模式] [-u io_uring] [-r SO_REUSEPORT] [-P 经过任务线程池] [-l 打印循环延迟]"
+                  << " [-h 服务器地址，给出时不启动内置服务器] [-p 端口，默认" << options.port_ << "]" << std::endl;
+    }
+
+    // 解析命令行，options中是各程序自己的默认值
+    inline bool parseOptions(int argc, char* argv[], Options* options)
+    {
+        int opt;
+        while((opt = getopt(argc, argv, "t:c:s:n:d:w:eurPlh:p:")) != -1)
+        {
+            switch(opt)
+            {
+                case 't': options->ioThreads_     = atoi(optarg); break;
+                case 'c': options->connections_   = atoi(optarg); break;
+                case 's': options->messageSize_   = atoi(optarg); break;
+                case 'n': options->depth_         = atoi(optarg); break;
+                case 'd': options->seconds_       = atoi(optarg); break;
+                case 'w': options->clientThreads_ = atoi(optarg); break;
+                case 'e': options->edgeTriggered_ = true; break;
+                case 'u': options->ioUring_       = true; break;
+                case 'r': options->reusePort_     = true; break;
+                case 'P': options->usePool_       = true; break;
+                case 'l': options->loopLag_       = true; break;
+                case 'h': options->host_          = optarg; break;
+                case 'p': options->port_          = optarg; break;
+                default:
+                    usage(argv[0], *options);
+                    return false;
+            }
+        }
+
+        if(options->ioThreads_ < 1 || options->connections_ < 1 || options->messageSize_ < 1 ||
+           options->depth_ < 1 || options->seconds_ < 1 || options->clientThreads_ < 1)
+        {
+            usage(argv[0], *options);
+            return false;
+        }
+        if(options->clientThreads_ > options->connections_)
+            options->clientThreads_ = options->connections_;
+        return true;
+    }
+
+    /************************************************************************************************************/
+
+    // 回显，在IO线程中直接发送
+    inline void echoInLoop(const std::shared_ptr<TcpConnection> conn, Buffer* inputBuffer, struct sockaddr_in)
+    {
+        conn->sendInLoop(inputBuffer->peek(), inputBuffer->readableBytes());
+        inputBuffer->retrieveAll();
+    }
+
+    inline void echoTask(const std::shared_ptr<TcpConnection> conn, std::string message)
+    {
+        conn->send(std::move(message));
+    }
+
+    // 回显，经过任务线程池；同一连接的任务按顺序执行，回显不会乱序
+    inline void echoInPool(const std::shared_ptr<TcpConnection> conn, Buffer* inputBuffer, struct sockaddr_in)
+    {
+        conn->addOrderedTaskToPool(std::bind(echoTask, conn, inputBuffer->retrieveAllAsString()));
+    }
+
+    // 在另一个线程中启动内置服务器，start()不返回
+    inline TcpServer* startServer(const Options& options)
+    {
+        TcpServer* server = new TcpServer(2, options.ioThreads_, options.port_,
+                                          [](const std::shared_ptr<TcpConnection>){},
+                                          options.usePool_ ? onMessage(echoInPool) : onMessage(echoInLoop),
+                                          [](const std::shared_ptr<TcpConnection>){},
+                                          options.ioUring_ ? Poller::kIoUring : Poller::kEpoll);
+        server->setEdgeTriggered(options.edgeTriggered_);
+        server->setReusePort(options.reusePort_);
+        if(options.usePool_)
+        {
+            server->setTaskLimit(1 << 20, 1 << 19);
+            server->setBackpressure(true);
+        }
+
+        std::thread(&TcpServer::start, server).detach();
+        return server;
+    }
+
+    /************************************************************************************************************/
+
+    // 客户端的一个连接
+    struct ClientConnection
+    {
+        int    fd_;
+        size_t outPending_;  // 还没写出的字节数
+        size_t received_;    // 当前这条消息已收到的字节数
+        bool   writing_;     // 是否关注了EPOLLOUT
+        std::deque<int64_t> sendTimes_; // 在途消息的发送时间，回显按顺序返回
+    };
+
+    // 一个客户端线程的统计
+    struct ClientResult
+    {
+        int64_t messages_;
+        int64_t bytes_;
+        bool    failed_;
+        LatencyHistogram latency_;
+    };
+
+    inline int connectTo(const Options& options)
+    {
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof addr);
+        addr.sin_family = AF_INET;
+        addr.sin_port   = htons(static_cast<uint16_t>(atoi(options.port_.c_str())));
+        inet_pton(AF_INET, options.host_.empty() ? "127.0.0.1" : options.host_.c_str(), &addr.sin_addr);
+
+        // 内置服务器可能还没开始监听，重试一会
+        for(int retry=0;retry < 100;++retry)
+        {
+            int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            if(::connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof addr) == 0)
+            {
+                int on = 1;
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof on);
+                fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+                return fd;
+            }
+            ::close(fd);
+            usleep(10 * 1000);
+        }
+        return -1;
+    }
+
+    // 写出outPending_，写不完时关注EPOLLOUT
+    inline bool flushConnection(int epollfd, ClientConnection& conn, const std::string& sendBuffer)
+    {
+        while(conn.outPending_ > 0)
+        {
+            ssize_t n = ::write(conn.fd_, sendBuffer.data(), std::min(conn.outPending_, sendBuffer.size()));
+            if(n < 0)
+            {
+                if(errno != EAGAIN)
+                    return false;
+                break;
+            }
+            conn.outPending_ -= static_cast<size_t>(n);
+        }
+
+        bool writing = conn.outPending_ > 0;
+        if(writing != conn.writing_)
+        {
+            conn.writing_ = writing;
+            struct epoll_event event;
+            event.events  = writing ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+            event.data.ptr = &conn;
+            epoll_ctl(epollfd, EPOLL_CTL_MOD, conn.fd_, &event);
+        }
+        return true;
+    }
+
+    // 客户端线程：管理connections个连接，到deadlineNs为止
+    inline void runClient(const Options& options, int connections, int64_t deadlineNs, ClientResult* result)
+    {
+        const size_t messageSize = static_cast<size_t>(options.messageSize_);
+        std::string sendBuffer(std::max(messageSize, static_cast<size_t>(64 * 1024)), 'x');
+        std::vector<char> recvBuffer(64 * 1024);
+
+        int epollfd = epoll_create1(EPOLL_CLOEXEC);
+        std::vector<ClientConnection> conns(connections);
+        for(ClientConnection& conn : conns)
+        {
+            conn.fd_         = connectTo(options);
+            conn.outPending_ = 0;
+            conn.received_   = 0;
+            conn.writing_    = false;
+            if(conn.fd_ < 0)
+            {
+                result->failed_ = true;
+                return;
+            }
+
+            struct epoll_event event;
+            event.events   = EPOLLIN;
+            event.data.ptr = &conn;
+            epoll_ctl(epollfd, EPOLL_CTL_ADD, conn.fd_, &event);
+        }
+
+        // 每个连接先发出depth条
+        int64_t now = monotonicNanoSeconds();
+        for(ClientConnection& conn : conns)
+        {
+            for(int i=0;i < options.depth_;++i)
+                conn.sendTimes_.push_back(now);
+            conn.outPending_ = messageSize * options.depth_;
+            flushConnection(epollfd, conn, sendBuffer);
+        }
+
+        std::vector<struct epoll_event> events(connections);
+        while(monotonicNanoSeconds() < deadlineNs)
+        {
+            int numEvent = epoll_wait(epollfd, events.data(), connections, 100);
+            for(int i=0;i < numEvent;++i)
+            {
+                ClientConnection& conn = *static_cast<ClientConnection*>(events[i].data.ptr);
+
+                if(events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+                {
+                    ssize_t n = ::read(conn.fd_, recvBuffer.data(), recvBuffer.size());
+                    if(n == 0 || (n < 0 && errno != EAGAIN))
+                    {
+                        result->failed_ = true;
+                        deadlineNs = 0;
+                        break;
+                    }
+                    if(n > 0)
+                    {
+                        result->bytes_ += n;
+                        conn.received_ += static_cast<size_t>(n);
+
+                        // 每收齐一条，记下往返延迟并补发一条
+                        now = monotonicNanoSeconds();
+                        while(conn.received_ >= messageSize && !conn.sendTimes_.empty())
+                        {
+                            conn.received_ -= messageSize;
+                            result->latency_.record(now - conn.sendTimes_.front());
+                            conn.sendTimes_.pop_front();
+                            ++result->messages_;
+
+                            conn.sendTimes_.push_back(now);
+                            conn.outPending_ += messageSize;
+                        }
+                    }
+                }
+
+                if(!flushConnection(epollfd, conn, sendBuffer))
+                {
+                    result->failed_ = true;
+                    deadlineNs = 0;
+                    break;
+                }
+            }
+        }
+
+        for(ClientConnection& conn : conns)
+            ::close(conn.fd_);
+        ::close(epollfd);
+    }
+
+    /************************************************************************************************************/
+
+    // 启动服务器和客户端线程，打印结果
+    inline int runBenchmark(const char* name, const Options& options)
+    {
+        TcpServer* server = nullptr;
+        if(options.host_.empty())
+            server = startServer(options);
+
+        std::vector<std::unique_ptr<ClientResult>> results;
+        std::vector<std::thread> clients;
+        int64_t beginNs    = monotonicNanoSeconds();
+        int64_t deadlineNs = beginNs + static_cast<int64_t>(options.seconds_) * 1000 * 1000 * 1000;
+        for(int i=0;i < options.clientThreads_;++i)
+        {
+            // 连接尽量平均分给各客户端线程
+            int connections = options.connections_ / options.clientThreads_ +
+                              (i < options.connections_ % options.clientThreads_ ? 1 : 0);
+            results.emplace_back(new ClientResult());
+            results.back()->messages_ = 0;
+            results.back()->bytes_    = 0;
+            results.back()->failed_   = false;
+            clients.emplace_back(runClient, std::cref(options), connections, deadlineNs, results.back().get());
+        }
+        for(std::thread& client : clients)
+            client.join();
+        double seconds = (monotonicNanoSeconds() - beginNs) / 1e9;
+
+        int64_t messages = 0;
+        int64_t bytes    = 0;
+        bool    failed   = false;
+        LatencyHistogram latency;
+        for(const std::unique_ptr<ClientResult>& result : results)
+        {
+            messages += result->messages_;
+            bytes    += result->bytes_;
+            failed    = failed || result->failed_;
+            latency.merge(result->latency_);
+        }
+
+        std::cout << name << ": io threads " << options.ioThreads_
+                  << ", connections " << options.connections_
+                  << ", message " << options.messageSize_ << " bytes"
+                  << ", depth " << options.depth_
+                  << ", " << (options.ioUring_ ? "io_uring" : (options.edgeTriggered_ ? "epoll ET" : "epoll LT"))
+                  << (options.reusePort_ ? ", reuseport" : "")
+                  << (options.usePool_ ? ", task pool" : "") << std::endl;
+        if(failed)
+            std::cout << "连接失败或被断开，结果不完整" << std::endl;
+
+        std::cout << "messages " << messages << " in " << seconds << "s: "
+                  << static_cast<int64_t>(messages / seconds) << " msg/s, "
+                  << bytes / seconds / (1024 * 1024) << " MiB/s" << std::endl;
+        std::cout << "latency us: mean " << latency.mean() / 1000.0
+                  << " p50 " << latency.percentile(50) / 1000.0
+                  << " p90 " << latency.percentile(90) / 1000.0
+                  << " p99 " << latency.percentile(99) / 1000.0
+                  << " p999 " << latency.percentile(99.9) / 1000.0
+                  << " max " << latency.max() / 1000.0 << std::endl;
+
+        if(server && options.loopLag_)
+            std::cout << server->getLoopLagReport();
+
+        return failed ? 1 : 0;
+    }
+}
+
+#endif //BENCHCOMMON_H
@@ -0,0 +1,32 @@
+#include "benchCommon.h"
+
+using namespace bench;
+
+/*
+ *  echo吞吐
+ *  每个连接流水线发送多条消息，测服务器回显的消息数/s、MB/s，以及流水线下的往返延迟
+ *  用法：benchEcho [-t IO线程数] [-c 连接数] [-s 消息字节数] [-n 在途消息数] [-d 秒数] [-w 客户端线程数] [-e] [-u] [-r] [-P] [-l]
+ *  例如比较IO线程数：benchEcho -t 1 -c 64 -s 4096; benchEcho -t 4 -c 64 -s 4096
+ */
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    options.ioThreads_     = 1;
+    options.connections_   = 64;
+    options.messageSize_   = 4096;
+    options.depth_         = 8;
+    options.seconds_       = 5;
+    options.clientThreads_ = 1;
+    options.edgeTriggered_ = false;
+    options.ioUring_       = false;
+    options.reusePort_     = false;
+    options.usePool_       = false;
+    options.loopLag_       = false;
+    options.port_          = "19888";
+
+    if(!parseOptions(argc, argv, &options))
+        exit(2);
+
+    exit(runBenchmark("echo", options));
+}
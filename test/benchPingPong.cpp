@@ -0,0 +1,31 @@
+#include "benchCommon.h"
+
+using namespace bench;
+
+/*
+ *  ping-pong延迟
+ *  每个连接只有一条消息在途，收到回显后才发下一条，测往返延迟的分布和此时的消息数/s
+ *  用法：benchPingPong [-t IO线程数] [-c 连接数] [-s 消息字节数] [-d 秒数] [-w 客户端线程数] [-e] [-u] [-r] [-P] [-l]
+ */
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    options.ioThreads_     = 1;
+    options.connections_   = 16;
+    options.messageSize_   = 64;
+    options.depth_         = 1;
+    options.seconds_       = 5;
+    options.clientThreads_ = 1;
+    options.edgeTriggered_ = false;
+    options.ioUring_       = false;
+    options.reusePort_     = false;
+    options.usePool_       = false;
+    options.loopLag_       = false;
+    options.port_          = "19889";
+
+    if(!parseOptions(argc, argv, &options))
+        exit(2);
+
+    exit(runBenchmark("pingpong", options));
+}
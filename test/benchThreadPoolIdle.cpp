@@ -0,0 +1,61 @@
+#include <unistd.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <iostream>
+
+#include "../base/ThreadPool.h"
+
+using namespace base;
+using namespace std;
+
+/*
+ *  线程池空闲时的CPU占用
+ *  先投递一批任务让线程池扩容，任务做完后统计接下来若干秒整个进程消耗的CPU时间（用户态+内核态）
+ *  用法：benchThreadPoolIdle [空闲秒数，默认5] [最少线程数，默认4]
+ */
+
+static double cpuSeconds()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 +
+           usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+}
+
+static double wallSeconds()
+{
+    return monotonicMicroSeconds() / 1e6;
+}
+
+void taskFunc(void)
+{
+    usleep(20 * 1000);
+}
+
+int main(int argc, char* argv[])
+{
+    int idleSeconds = argc > 1 ? atoi(argv[1]) : 5;
+    int minThread   = argc > 2 ? atoi(argv[2]) : 4;
+
+    ThreadPool pool(minThread);
+    pool.startPool();
+
+    // 制造一段负载让线程池扩容，之后空闲线程会被逐个回收
+    for(int i=0;i < 30;++i)
+        pool.addTask(taskFunc);
+    sleep(1);
+
+    double cpuBegin  = cpuSeconds();
+    double wallBegin = wallSeconds();
+    sleep(idleSeconds);
+    double cpu  = cpuSeconds() - cpuBegin;
+    double wall = wallSeconds() - wallBegin;
+
+    cout << "idle " << wall << "s, cpu " << cpu * 1000 << "ms (" << cpu / wall * 100 << "%)" << endl;
+
+    double stopBegin = wallSeconds();
+    pool.stopPool();
+    cout << "stopPool " << (wallSeconds() - stopBegin) * 1000 << "ms" << endl;
+
+    exit(0);
+}
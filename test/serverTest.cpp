@@ -1,13 +1,14 @@
-#include <iostream>
-
 #include "../base/TcpServer.h"
+#include "../base/AsyncLogging.h"
+#include "../base/Logging.h"
 
 using namespace base;
 
-void onConnectionFunc(void *peerptr)
+void onConnectionFunc(const std::shared_ptr<TcpConnection> conn)
 {
-    struct sockaddr_in *peeraddr = static_cast<struct sockaddr_in *>(peerptr);
-    std::cout << "有连接建立/断开!" << "[" << inet_ntoa(peeraddr->sin_addr) << ":" << ntohs(peeraddr->sin_port) << "]" << std::endl;
+    const struct sockaddr_in& peeraddr = conn->getPeerAddr();
+    LOG_INFO << (conn->isConnected() ? "有连接建立!" : "有连接断开!") << "[" << inet_ntoa(peeraddr.sin_addr) << ":" << ntohs(peeraddr.sin_port) << "]" \
+    << " id " << conn->getId();
 }
 
 // 任务函数，在任务线程中被执行
@@ -19,7 +20,7 @@ void taskFunction(const std::shared_ptr<TcpConnection> conn,std::string message)
     //
 
     // 发送处理结果
-    std::cout << "taskFunction被执行" << std::endl;
+    LOG_DEBUG << "taskFunction被执行";
     conn->send(std::move(message)); // 跨线程调用
 }
 
@@ -28,24 +29,33 @@ void onMessageFunc(const std::shared_ptr<TcpConnection> conn,
 {
     std::string message = inputBuffer->retrieveAllAsString();
 
-    std::cout << "从" << "[" << inet_ntoa(peeraddr.sin_addr) << ":" << ntohs(peeraddr.sin_port) << "]" \
-    << "收到消息：" << message <<std::endl;
+    LOG_INFO << "从" << "[" << inet_ntoa(peeraddr.sin_addr) << ":" << ntohs(peeraddr.sin_port) << "]" \
+    << "收到消息：" << message;
 
     conn->addTaskToPool(std::bind(taskFunction,conn,std::move(message))); // 向任务池投入一个任务，由任务线程执行
 }
 
-void onWriteCompleteFunc(struct sockaddr_in peeraddr)
+void onWriteCompleteFunc(const std::shared_ptr<TcpConnection> conn)
 {
-    std::cout << "给" << "[" << inet_ntoa(peeraddr.sin_addr) << ":" << ntohs(peeraddr.sin_port) << "]" \
-    << "的消息发送完毕" << std::endl;
+    const struct sockaddr_in& peeraddr = conn->getPeerAddr();
+    LOG_INFO << "给" << "[" << inet_ntoa(peeraddr.sin_addr) << ":" << ntohs(peeraddr.sin_port) << "]" \
+    << "的消息发送完毕";
 }
 
 int main()
 {
+    // 日志由后台线程写入serverTest.*.log，IO线程、任务线程写日志时不争stdout的锁
+    AsyncLogging asyncLog("serverTest");
+    asyncLog.start();
+    Logger::setOutput(std::bind(&AsyncLogging::append,&asyncLog,std::placeholders::_1,std::placeholders::_2));
+    Logger::setFlush(std::bind(&AsyncLogging::stop,&asyncLog));
+
     TcpServer server(3,3,"1888",onConnectionFunc,onMessageFunc,onWriteCompleteFunc);
 
-    std::cout << "server创建完毕" <<std::endl;
+    LOG_INFO << "server创建完毕";
     server.start();
 
+    // exit()不会析构asyncLog，先停止后台线程，把暂存的日志写完
+    asyncLog.stop();
     exit(0);
-}
\ No newline at end of file
+}